@@ -0,0 +1,213 @@
+#include "harness.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdio>
+#include "util.hpp"
+
+
+BenchRunner::BenchRunner(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        
+        if (i + 1 >= argc) {
+            std::cerr << "Unrecognized option or missing argument: '" << flag << "'.\n";
+            std::exit(1);
+        }
+        
+        std::string value = argv[++i];
+        
+        if (flag == "-filter")
+            filter = value;
+        else if (flag == "-repetitions")
+            repetitions = std::max(1, std::atoi(value.c_str()));
+        else if (flag == "-min-time")
+            minTime = std::max(1.0, std::atof(value.c_str()));
+        else if (flag == "-json")
+            jsonPath = value;
+        else if (flag == "-compare")
+            comparePath = value;
+        else {
+            std::cerr << "Unrecognized option: '" << flag << "'.\n";
+            std::exit(1);
+        }
+    }
+}
+
+bool BenchRunner::selected(const std::string &name) const {
+    return name.find(filter) != std::string::npos;
+}
+
+void BenchRunner::run(const std::string &name, const Benchmark &benchmark, double items) {
+    if (!selected(name))
+        return;
+    
+    const double target = minTime * 1e6;
+    
+    // Calibration, which doubles as the first warm-up.
+    std::uint64_t n = 1;
+    double elapsed;
+    
+    while ((elapsed = static_cast<double>(benchmark(n))) < target / 10 && n < (1ull << 40))
+        n *= 2;
+    
+    // A single operation slower than the minimum time was warm-up enough.
+    if (elapsed < target) {
+        n = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(n * target / std::max(elapsed, 1.0)));
+        benchmark(n);
+    }
+    
+    std::vector<double> samples;
+    for (int i = 0; i < repetitions; i++)
+        samples.push_back(static_cast<double>(benchmark(n)) / n);
+    
+    std::sort(samples.begin(), samples.end());
+    
+    double mean = 0;
+    for (auto s : samples)
+        mean += s;
+    mean /= samples.size();
+    
+    double variance = 0;
+    for (auto s : samples)
+        variance += (s - mean) * (s - mean);
+    
+    Json::Value result;
+    result["name"]        = name;
+    result["ns_per_op"]   = samples[samples.size() / 2];
+    result["min"]         = samples.front();
+    result["max"]         = samples.back();
+    result["stddev"]      = std::sqrt(variance / samples.size());
+    result["iterations"]  = Json::UInt64(n);
+    result["repetitions"] = repetitions;
+    result["items_per_second"] = items * 1e9 / samples[samples.size() / 2];
+    
+    results.append(result);
+    
+    std::cerr <<
+    std::left  << std::setw(40) << name <<
+    std::right << std::setw(14) << std::fixed << std::setprecision(1) << result["ns_per_op"].asDouble() << " ns/op" <<
+    "  +-" << std::setprecision(1) << 100 * result["stddev"].asDouble() / mean << "%\n";
+}
+
+int BenchRunner::finish() {
+    Json::Value root;
+    root["benchmarks"] = results;
+    
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    
+    if (jsonPath == "-")
+        std::cout << Json::writeString(builder, root) << '\n';
+    else if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out) {
+            std::cerr << "Failed to write: '" << jsonPath << "'.\n";
+            return 1;
+        }
+        
+        out << Json::writeString(builder, root) << '\n';
+    }
+    
+    if (comparePath.empty())
+        return 0;
+    
+    std::ifstream in(comparePath);
+    Json::Value baseline;
+    Json::Reader reader;
+    
+    if (!in || !reader.parse(in, baseline)) {
+        std::cerr << "Failed to read: '" << comparePath << "'.\n";
+        return 1;
+    }
+    
+    std::cerr << "\nCompared with " << comparePath << ":\n";
+    
+    for (auto &result : results) {
+        for (auto &old : baseline["benchmarks"]) {
+            if (old["name"] != result["name"])
+                continue;
+            
+            double before = old["ns_per_op"].asDouble(), after = result["ns_per_op"].asDouble();
+            
+            std::cerr <<
+            std::left  << std::setw(40) << result["name"].asString() <<
+            std::right << std::setw(14) << std::setprecision(1) << before << " -> " <<
+            std::setw(14) << after << " ns/op  " <<
+            std::showpos << std::setprecision(1) << 100 * (after - before) / before << std::noshowpos << "%\n";
+        }
+    }
+    
+    return 0;
+}
+
+TempDir::TempDir() {
+    const char *base = std::getenv("TMPDIR");
+    
+    std::string pattern = std::string(base ? base : "/tmp") + "/deathgame-bench-XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+    
+    if (!mkdtemp(buffer.data()))
+        throw std::runtime_error("Failed to create a temporary directory.");
+    
+    path = buffer.data();
+}
+
+TempDir::~TempDir() {
+    for (auto &file : files)
+        std::remove(file.c_str());
+    
+    sys::rmdir(path.c_str());
+}
+
+std::string TempDir::write(const std::string &name, const std::string &contents) {
+    auto file = path + '/' + name;
+    
+    std::ofstream out(file, std::ios::binary);
+    out << contents;
+    
+    if (!out)
+        throw std::runtime_error("Failed to write: '" + file + "'.");
+    
+    if (std::find(files.begin(), files.end(), file) == files.end())
+        files.push_back(file);
+    
+    return file;
+}
+
+Json::Value GameFixture::makeConfig(
+    TempDir &dir,
+    int columns, int rows, int unitsPerLeague,
+    const std::vector<std::string> &programs
+) {
+    static const char *colors[] = {"#FF4040", "#40FF40", "#4040FF", "#FFFF40", "#FF40FF", "#40FFFF", "#FFFFFF", "#808080"};
+    
+    Json::Value root;
+    root["columnNumber"]   = columns;
+    root["rowNumber"]      = rows;
+    root["unitsPerLeague"] = unitsPerLeague;
+    root["moveDelay"]      = 0;
+    root["headless"]       = true;
+    
+    for (std::size_t i = 0; i < programs.size(); i++) {
+        auto name = "league" + std::to_string(i);
+        
+        dir.write(name + ".dasm", programs[i]);
+        
+        auto &league = root["leagues"][name];
+        league["directory"] = dir.getPath();
+        league["unitKinds"]["start"]["exec"]   = name + ".dasm";
+        league["unitKinds"]["start"]["sprite"] = colors[i % 8];
+    }
+    
+    return root;
+}
+
+League &GameFixture::getLeague(std::size_t i) {
+    return *game.findLeague("league" + std::to_string(i));
+}
@@ -0,0 +1,107 @@
+#ifndef BENCH_HARNESS_HPP
+#define BENCH_HARNESS_HPP
+
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <json/json.h>
+#include "config.hpp"
+#include "game.hpp"
+
+
+/*
+ * BenchRunner.
+ *
+ * Each benchmark is a function that performs n operations and returns the
+ * nanoseconds they took, so that per-batch setup can be left out of the
+ * measurement. The runner calibrates n to the minimum time, runs one
+ * warm-up repetition and then reports the median, spread and deviation
+ * of the repetitions in ns/op, as a table on stderr and as JSON.
+ *
+ * Options: -filter SUBSTRING, -repetitions N, -min-time MS,
+ *          -json PATH ('-' for stdout), -compare PATH.
+ */
+
+class BenchRunner {
+public:
+    typedef std::function<std::uint64_t(std::uint64_t n)> Benchmark;
+    
+    BenchRunner(int argc, char *argv[]);
+    
+    bool selected(const std::string &name) const;
+    
+    // 'items' is the amount of work in one operation, e.g. lines parsed.
+    void run(const std::string &name, const Benchmark &benchmark, double items = 1);
+    
+    // Writes the results; returns the process exit code.
+    int finish();
+    
+private:
+    std::string filter, jsonPath, comparePath;
+    int repetitions = 5;
+    double minTime = 200;
+    
+    Json::Value results = Json::Value(Json::arrayValue);
+};
+
+template <class F>
+static inline std::uint64_t Time(F &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Keeps the compiler from dropping a result.
+template <class T>
+static inline void Consume(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/*
+ * TempDir.
+ *
+ * A scratch directory removed with everything written through it.
+ */
+
+class TempDir {
+public:
+    TempDir();
+    ~TempDir();
+    
+    const std::string &getPath() const noexcept {return path;}
+    
+    // Returns the path of the written file.
+    std::string write(const std::string &name, const std::string &contents);
+    
+private:
+    std::string path;
+    std::vector<std::string> files;
+};
+
+/*
+ * GameFixture.
+ *
+ * A headless game with one league per program, each with a single unit
+ * kind running it, on a columns x rows board.
+ */
+
+struct GameFixture {
+    Config config;
+    Game   game;
+    
+    GameFixture(const Json::Value &root) : config(root), game(config) {}
+    
+    static Json::Value makeConfig(
+        TempDir &dir,
+        int columns, int rows, int unitsPerLeague,
+        const std::vector<std::string> &programs
+    );
+    
+    League &getLeague(std::size_t i);
+};
+
+
+#endif
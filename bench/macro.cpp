@@ -0,0 +1,349 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <exception>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "harness.hpp"
+#include "util.hpp"
+
+
+/*
+ * Macro-benchmarks: seeded headless games run for a fixed number of moves,
+ * each in its own process so that the peak RSS is its own. The final board
+ * hash is checked against the golden value, so that a faster engine is
+ * also shown to play the same games.
+ *
+ * Options: -filter SUBSTRING, -repetitions N, -json PATH ('-' for stdout),
+ *          -golden PATH, -update-golden, -example DIR.
+ */
+
+struct Scenario {
+    std::string name;
+    int moves;
+    std::function<Json::Value(TempDir &)> makeConfig;
+};
+
+struct ScenarioResult {
+    int moves = 0;
+    double setupSeconds = 0, runSeconds = 0;
+    long peakRSS = 0;
+    std::uint64_t hash = 0;
+};
+
+static const std::uint64_t scenarioSeed = 20161019;
+
+static std::string exampleDir = "example";
+
+static Json::Value MakeEightLeagues(TempDir &dir, int side, int unitsPerLeague) {
+    static const char *programs[] = {
+        "turn r\ngo\neat\nj 0\n",
+        "eat\njl 12 0\nclon\nj 0\n",
+        "je 4\neat 2\ngo\nj 0\nstr 5\nj 0\n",
+        "eat 12\nclon\nturn r\nj 0\n"
+    };
+    
+    std::vector<std::string> leagues;
+    for (int i = 0; i < 8; i++)
+        leagues.push_back(programs[i % 4]);
+    
+    return GameFixture::makeConfig(dir, side, side, unitsPerLeague, leagues);
+}
+
+static std::vector<Scenario> GetScenarios() {
+    return {
+        {"bees-vs-chickens", 200000, [](TempDir &) {
+            Json::Value root;
+            Json::Reader reader;
+            
+            std::ifstream in(exampleDir + "/config.json");
+            if (!in || !reader.parse(in, root))
+                throw std::runtime_error("Failed to read: '" + exampleDir + "/config.json'.");
+            
+            for (auto &league : root["leagues"].getMemberNames())
+                root["leagues"][league]["directory"] = exampleDir + '/' + root["leagues"][league].get("directory", league).asString();
+            
+            return root;
+        }},
+        
+        {"8-leagues-1000x1000", 2000000, [](TempDir &dir) {
+            return MakeEightLeagues(dir, 1000, 5000);
+        }},
+        
+        // The same with the board in tiles, which must not change the game.
+        {"8-leagues-1000x1000-tiled", 2000000, [](TempDir &dir) {
+            auto root = MakeEightLeagues(dir, 1000, 5000);
+            root["boardTile"] = 16;
+            
+            return root;
+        }},
+        
+        // A board well past the caches, where the order of the units counts;
+        // sorted, they play different games than in insertion order.
+        {"8-leagues-2000x2000", 4000000, [](TempDir &dir) {
+            return MakeEightLeagues(dir, 2000, 60000);
+        }},
+        
+        {"8-leagues-2000x2000-morton", 4000000, [](TempDir &dir) {
+            auto root = MakeEightLeagues(dir, 2000, 60000);
+            root["unitOrder"] = "morton";
+            
+            return root;
+        }},
+        
+        {"8-leagues-2000x2000-hilbert", 4000000, [](TempDir &dir) {
+            auto root = MakeEightLeagues(dir, 2000, 60000);
+            root["unitOrder"] = "hilbert";
+            
+            return root;
+        }},
+        
+        {"combat-stress", 1000000, [](TempDir &dir) {
+            static const char *programs[] = {
+                "eat 12\nje 4\nclon\nj 0\nstr 5\nj 0\n",
+                "je 4\neat 2\ngo\nj 0\nstr 9\nj 0\n"
+            };
+            
+            return GameFixture::makeConfig(dir, 200, 200, 4000, {programs[0], programs[1], programs[0], programs[1]});
+        }}
+    };
+}
+
+static ScenarioResult RunScenario(const Scenario &scenario) {
+    ScenarioResult result;
+    
+    TempDir dir;
+    
+    auto root = scenario.makeConfig(dir);
+    root["headless"] = true;
+    root["seed"]     = Json::UInt64(scenarioSeed);
+    
+    std::unique_ptr<GameFixture> fixture;
+    
+    result.setupSeconds = Time([&] {
+        fixture.reset(new GameFixture(root));
+    }) / 1e9;
+    
+    auto &game = fixture->game;
+    
+    result.runSeconds = Time([&] {
+        game.step(scenario.moves - game.getMove());
+    }) / 1e9;
+    
+    result.moves = game.getMove();
+    result.hash  = game.hashBoard();
+    
+    return result;
+}
+
+// Runs the scenario in a child process which reports back through a pipe.
+static ScenarioResult ForkScenario(const Scenario &scenario) {
+    int fds[2];
+    if (pipe(fds))
+        throw std::runtime_error("Failed to create a pipe.");
+    
+    pid_t pid = fork();
+    
+    if (pid < 0)
+        throw std::runtime_error("Failed to fork.");
+    
+    if (!pid) {
+        close(fds[0]);
+        
+        std::ostringstream out;
+        
+        try {
+            auto result = RunScenario(scenario);
+            out << "ok " << result.moves << ' ' << result.setupSeconds << ' ' << result.runSeconds << ' ' << result.hash;
+        } catch (const std::exception &e) {
+            out << "error " << e.what();
+        }
+        
+        auto message = out.str();
+        ssize_t written = write(fds[1], message.data(), message.size());
+        
+        _exit(written == static_cast<ssize_t>(message.size()) ? 0 : 1);
+    }
+    
+    close(fds[1]);
+    
+    std::string message;
+    char buffer[256];
+    ssize_t n;
+    
+    while ((n = read(fds[0], buffer, sizeof buffer)) > 0)
+        message.append(buffer, n);
+    
+    close(fds[0]);
+    
+    int status;
+    struct rusage usage;
+    
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        throw std::runtime_error("Scenario '" + scenario.name + "' crashed.");
+    
+    std::istringstream in(message);
+    std::string tag;
+    in >> tag;
+    
+    if (tag != "ok")
+        throw std::runtime_error("Scenario '" + scenario.name + "' failed: " + message.substr(std::min<std::size_t>(6, message.size())));
+    
+    ScenarioResult result;
+    in >> result.moves >> result.setupSeconds >> result.runSeconds >> result.hash;
+    
+    result.peakRSS = usage.ru_maxrss;
+    
+    return result;
+}
+
+static std::string HexHash(std::uint64_t hash) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return out.str();
+}
+
+int main(int argc, char *argv[]) {
+    std::string filter, jsonPath, goldenPath = "bench/golden.json";
+    int repetitions = 1;
+    bool updateGolden = false;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        
+        if (flag == "-update-golden") {
+            updateGolden = true;
+            continue;
+        }
+        
+        if (i + 1 >= argc) {
+            std::cerr << "Unrecognized option or missing argument: '" << flag << "'.\n";
+            return 1;
+        }
+        
+        std::string value = argv[++i];
+        
+        if (flag == "-filter")
+            filter = value;
+        else if (flag == "-repetitions")
+            repetitions = std::max(1, std::atoi(value.c_str()));
+        else if (flag == "-json")
+            jsonPath = value;
+        else if (flag == "-golden")
+            goldenPath = value;
+        else if (flag == "-example")
+            exampleDir = value;
+        else {
+            std::cerr << "Unrecognized option: '" << flag << "'.\n";
+            return 1;
+        }
+    }
+    
+    Json::Value golden(Json::objectValue);
+    
+    {
+        std::ifstream in(goldenPath);
+        Json::Reader reader;
+        
+        if (in && !reader.parse(in, golden)) {
+            std::cerr << "Failed to read: '" << goldenPath << "'.\n";
+            return 1;
+        }
+    }
+    
+    Json::Value results(Json::arrayValue);
+    bool mismatch = false;
+    
+    try {
+        for (auto &scenario : GetScenarios()) {
+            if (scenario.name.find(filter) == std::string::npos)
+                continue;
+            
+            std::vector<ScenarioResult> runs;
+            
+            for (int i = 0; i < repetitions; i++) {
+                runs.push_back(ForkScenario(scenario));
+                
+                if (runs.back().hash != runs.front().hash)
+                    throw std::runtime_error("Scenario '" + scenario.name + "' is not reproducible.");
+            }
+            
+            std::sort(runs.begin(), runs.end(), [](const ScenarioResult &a, const ScenarioResult &b) {
+                return a.runSeconds < b.runSeconds;
+            });
+            
+            auto &median = runs[runs.size() / 2];
+            
+            long peakRSS = 0;
+            for (auto &run : runs)
+                peakRSS = std::max(peakRSS, run.peakRSS);
+            
+            auto hash = HexHash(median.hash);
+            auto &expected = golden[scenario.name];
+            
+            std::string check;
+            
+            if (updateGolden) {
+                expected["moves"] = median.moves;
+                expected["hash"]  = hash;
+                check = "updated";
+            } else if (expected.isNull())
+                check = "missing";
+            else if (expected["moves"].asInt() == median.moves && expected["hash"].asString() == hash)
+                check = "ok";
+            else {
+                check = "MISMATCH";
+                mismatch = true;
+            }
+            
+            Json::Value result;
+            result["name"]             = scenario.name;
+            result["moves"]            = median.moves;
+            result["setup_seconds"]    = median.setupSeconds;
+            result["wall_seconds"]     = median.runSeconds;
+            result["moves_per_second"] = median.moves / std::max(median.runSeconds, 1e-9);
+            result["peak_rss_kb"]      = Json::Int64(peakRSS);
+            result["hash"]             = hash;
+            result["golden"]           = check;
+            
+            results.append(result);
+            
+            std::cerr <<
+            std::left  << std::setw(28) << scenario.name <<
+            std::right << std::setw(10) << median.moves << " moves" <<
+            std::fixed << std::setprecision(3) << std::setw(10) << median.runSeconds << " s" <<
+            std::setprecision(0) << std::setw(12) << result["moves_per_second"].asDouble() << " moves/s" <<
+            std::setw(10) << peakRSS << " KiB  " <<
+            hash << ' ' << check << '\n';
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    
+    if (updateGolden) {
+        std::ofstream out(goldenPath);
+        out << Json::writeString(builder, golden) << '\n';
+    }
+    
+    Json::Value root;
+    root["scenarios"] = results;
+    
+    if (jsonPath == "-")
+        std::cout << Json::writeString(builder, root) << '\n';
+    else if (!jsonPath.empty())
+        std::ofstream(jsonPath) << Json::writeString(builder, root) << '\n';
+    
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,352 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <exception>
+#include "harness.hpp"
+#include "executable.hpp"
+#include "game.hpp"
+#include "ui.hpp"
+
+
+/*
+ * Micro-benchmarks of the engine's hot paths, see BenchRunner for the
+ * options.
+ */
+
+static std::string GenerateProgram(int lines) {
+    static const char *templates[] = {
+        "eat", "go 3", "clon", "str 2", "left", "right", "back", "turn r",
+        "jg 5 {}", "jl 7 {}", "j {}", "je {}", "eat r", "go r"
+    };
+    
+    std::string source;
+    
+    for (int i = 0; i < lines; i++) {
+        std::string line = templates[i % 14];
+        
+        auto hole = line.find("{}");
+        if (hole != std::string::npos)
+            line.replace(hole, 2, std::to_string((i * 7) % lines));
+        
+        source += line + '\n';
+    }
+    
+    return source;
+}
+
+static void BenchParse(BenchRunner &runner, TempDir &dir) {
+    for (int lines : {10, 100, 1000, 10000, 100000}) {
+        auto name = "parse/lines:" + std::to_string(lines);
+        if (!runner.selected(name))
+            continue;
+        
+        auto path = dir.write("parse" + std::to_string(lines) + ".dasm", GenerateProgram(lines));
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++) {
+                    Executable exec(path);
+                    Consume(exec.size());
+                }
+            });
+        }, lines);
+    }
+    
+    // Without the file system; one item is a byte of source.
+    for (int lines : {1000, 100000}) {
+        auto name = "parse/memory/lines:" + std::to_string(lines);
+        if (!runner.selected(name))
+            continue;
+        
+        auto source = GenerateProgram(lines);
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    Consume(Executable::fromSource(source).size());
+            });
+        }, source.size());
+    }
+}
+
+/*
+ * One operation is one Unit::execInsn() of a unit whose program is a single
+ * real instruction, possibly preceded by pseudo ones. The weight is kept
+ * high so that nothing dies of hunger or of its clones.
+ */
+
+static void BenchDispatch(BenchRunner &runner, TempDir &dir) {
+    static const std::vector<std::pair<std::string, std::string>> programs = {
+        {"eat",        "eat\n"},
+        {"go",         "go\n"},
+        {"clon",       "clon\n"},
+        {"str",        "str\n"},
+        {"left+eat",   "left\neat\n"},
+        {"right+eat",  "right\neat\n"},
+        {"back+eat",   "back\neat\n"},
+        {"turn+eat",   "turn r\neat\n"},
+        {"jg+eat",     "jg 1 1\neat\n"},
+        {"jl+eat",     "jl 1 1\neat\n"},
+        {"j+eat",      "j 1\neat\n"},
+        {"je+eat",     "je 1\neat\n"},
+        {"rep eat",    "eat 99\n"}
+    };
+    
+    for (auto &program : programs) {
+        auto name = "dispatch/" + program.first;
+        if (!runner.selected(name))
+            continue;
+        
+        GameFixture fixture(GameFixture::makeConfig(dir, 64, 64, 512, {program.second}));
+        
+        auto &game   = fixture.game;
+        auto &league = fixture.getLeague(0);
+        
+        for (auto &unit : league.units)
+            unit.setWeight(game, 1l << 40);
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    league.units[i % 512].execInsn(game, league);
+            });
+        });
+    }
+}
+
+static void BenchFindEnemy(BenchRunner &runner, TempDir &dir) {
+    for (int percent : {1, 10, 50, 90}) {
+        auto name = "findEnemy/density:" + std::to_string(percent) + "%";
+        if (!runner.selected(name))
+            continue;
+        
+        GameFixture fixture(GameFixture::makeConfig(dir, 256, 256, 256 * 256 * percent / 100, {"je 1\neat\n"}));
+        
+        auto &game   = fixture.game;
+        auto &league = fixture.getLeague(0);
+        auto  count  = league.units.size();
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    league.units[i % count].execInsn(game, league);
+            });
+        });
+    }
+    
+    // On a board far larger than the caches, by rows and in tiles.
+    for (int tile : {0, 8, 16}) {
+        auto name = "findEnemy/board:2048/tile:" + std::to_string(tile);
+        if (!runner.selected(name))
+            continue;
+        
+        auto root = GameFixture::makeConfig(dir, 2048, 2048, 2048 * 2048 / 10, {"je 1\neat\n"});
+        root["boardTile"] = tile;
+        
+        GameFixture fixture(root);
+        
+        auto &game   = fixture.game;
+        auto &league = fixture.getLeague(0);
+        auto  count  = league.units.size();
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    league.units[i % count].execInsn(game, league);
+            });
+        });
+    }
+}
+
+/*
+ * One operation is setting up a 512x512 game whose units take the given
+ * share of the cells; one item is a unit placed.
+ */
+
+static void BenchPlacement(BenchRunner &runner, TempDir &dir) {
+    const int cells = 511 * 511;
+    
+    for (int percent : {10, 50, 90, 100}) {
+        for (auto placement : {"random", "spread"}) {
+            auto name = "placement/" + std::string(placement) + "/density:" + std::to_string(percent) + "%";
+            if (!runner.selected(name))
+                continue;
+            
+            auto root = GameFixture::makeConfig(dir, 512, 512, cells * percent / 100, {"eat\n"});
+            root["placement"] = placement;
+            
+            Config config(root);
+            
+            runner.run(name, [&](std::uint64_t n) {
+                return Time([&] {
+                    for (std::uint64_t i = 0; i < n; i++) {
+                        Game game(config);
+                        Consume(game.getMove());
+                    }
+                });
+            }, cells * percent / 100);
+        }
+    }
+}
+
+// One operation is one Game::step() among many leagues of eaters.
+static void BenchStep(BenchRunner &runner, TempDir &dir) {
+    for (int leagues : {2, 100, 500}) {
+        auto name = "step/leagues:" + std::to_string(leagues);
+        if (!runner.selected(name))
+            continue;
+        
+        GameFixture fixture(GameFixture::makeConfig(dir, 256, 256, 10, std::vector<std::string>(leagues, "eat\n")));
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    Consume(fixture.game.step());
+            });
+        });
+    }
+    
+    // Longer slots and turns visit units and leagues less often per move.
+    for (int quantum : {1, 4, 16}) {
+        for (int batch : {1, 16}) {
+            auto name = "step/quantum:" + std::to_string(quantum) + "/batch:" + std::to_string(batch);
+            if (!runner.selected(name))
+                continue;
+            
+            auto root = GameFixture::makeConfig(dir, 256, 256, 100, std::vector<std::string>(8, "eat\n"));
+            root["quantum"] = quantum;
+            root["batch"]   = batch;
+            
+            GameFixture fixture(root);
+            
+            runner.run(name, [&](std::uint64_t n) {
+                return Time([&] {
+                    for (std::uint64_t i = 0; i < n; i++)
+                        Consume(fixture.game.step());
+                });
+            });
+        }
+    }
+}
+
+/*
+ * Every round kills one unit in 'every' and then walks the whole league,
+ * which makes getNextUnit() erase the dead; the league is refilled between
+ * rounds outside of the measurement.
+ */
+
+static void BenchNextUnit(BenchRunner &runner, TempDir &dir) {
+    for (int every : {0, 10, 2}) {
+        auto name = "getNextUnit/killed:" + std::string(every ? "1/" + std::to_string(every) : "none");
+        if (!runner.selected(name))
+            continue;
+        
+        const std::size_t size = 10000;
+        
+        GameFixture fixture(GameFixture::makeConfig(dir, 128, 128, size, {"eat\n"}));
+        
+        auto &league   = fixture.getLeague(0);
+        auto  template_ = league.units.front();
+        
+        runner.run(name, [&](std::uint64_t n) {
+            std::uint64_t elapsed = 0;
+            
+            while (n) {
+                while (league.units.size() < size)
+                    league.units.push_back(template_);
+                
+                if (every)
+                    for (std::size_t i = 0; i < size; i += every)
+                        league.units[i].setWeight(fixture.game, 0);
+                
+                auto round = std::min<std::uint64_t>(n, size);
+                
+                elapsed += Time([&] {
+                    for (std::uint64_t i = 0; i < round; i++)
+                        Consume(league.getNextUnit());
+                });
+                
+                n -= round;
+            }
+            
+            return elapsed;
+        });
+    }
+}
+
+static void BenchBiomass(BenchRunner &runner, TempDir &dir) {
+    for (int size : {100, 10000}) {
+        auto name = "getTotalBiomass/units:" + std::to_string(size);
+        if (!runner.selected(name))
+            continue;
+        
+        GameFixture fixture(GameFixture::makeConfig(dir, 128, 128, size, {"eat\n"}));
+        
+        auto &league = fixture.getLeague(0);
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    Consume(league.getTotalBiomass());
+            });
+        }, size);
+    }
+}
+
+/*
+ * Offscreen refreshes of a half-full board, once with cells of a few pixels
+ * and once small enough for the density map.
+ */
+
+static void BenchRefresh(BenchRunner &runner) {
+    for (int columns : {200, 2000}) {
+        auto name = "refresh/board:" + std::to_string(columns) + "x" + std::to_string(columns);
+        if (!runner.selected(name))
+            continue;
+        
+        UIDisplay display(0, 0, 0, 800, 800, columns, columns, false, "", UIDisplay::Output::Offscreen);
+        
+        SpriteID sprites[] = {
+            display.registerSprite(Sprite(255, 64, 64), 0),
+            display.registerSprite(Sprite(64, 255, 64), 1)
+        };
+        
+        for (int y = 0; y < columns; y++)
+            for (int x = 0; x < columns; x++)
+                if (GetRandom(2))
+                    display.blitSprite(x, y, sprites[GetRandom(2)]);
+        
+        runner.run(name, [&](std::uint64_t n) {
+            return Time([&] {
+                for (std::uint64_t i = 0; i < n; i++)
+                    display.refresh();
+            });
+        }, columns * columns);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BenchRunner runner(argc, argv);
+    
+    try {
+        UIInit(false);
+        
+        TempDir dir;
+        
+        BenchParse(runner, dir);
+        BenchDispatch(runner, dir);
+        BenchFindEnemy(runner, dir);
+        BenchPlacement(runner, dir);
+        BenchStep(runner, dir);
+        BenchNextUnit(runner, dir);
+        BenchBiomass(runner, dir);
+        BenchRefresh(runner);
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    
+    UIQuit();
+    
+    return runner.finish();
+}
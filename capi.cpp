@@ -0,0 +1,234 @@
+#include "deathgame.h"
+#include <string>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+#include "config.hpp"
+#include "game.hpp"
+#include "util.hpp"
+
+
+static_assert(std::is_same<SpriteID, unsigned>::value, "DGGetBoard() hands out SpriteIDs as unsigned.");
+
+struct DGConfig {
+    Config config;
+};
+
+struct DGGame {
+    Config config;
+    std::unique_ptr<Game> game;
+    
+    RandomState random;
+};
+
+static thread_local std::string lastError;
+
+/*
+ * Exceptions stop here: 'fn' runs and its result is returned, or 'failed'
+ * is and the message is kept for DGGetError().
+ */
+
+template <class T, class F>
+static T Guard(T failed, F fn) {
+    try {
+        return fn();
+    } catch (const std::exception &exc) {
+        lastError = exc.what();
+    } catch (...) {
+        lastError = "Unknown error.";
+    }
+    
+    return failed;
+}
+
+// Runs 'fn' on the game's random number stream.
+template <class F>
+static auto WithRandom(DGGame *game, F fn) -> decltype(fn()) {
+    struct Swap {
+        DGGame *game;
+        RandomState saved;
+        
+        Swap(DGGame *game) : game(game), saved(SwapRandom(game->random)) {}
+        ~Swap() {game->random = SwapRandom(saved);}
+    } swap(game);
+    
+    return fn();
+}
+
+const char *DGGetError(void) {
+    return lastError.c_str();
+}
+
+DGConfig *DGCreateConfig(const char *json, size_t length) {
+    return Guard<DGConfig *>(nullptr, [&] {
+        Json::Value root;
+        Json::Reader reader;
+        
+        if (!reader.parse(json, json + length, root))
+            throw ConfigError(reader);
+        
+        return new DGConfig {Config(root)};
+    });
+}
+
+void DGDestroyConfig(DGConfig *config) {
+    delete config;
+}
+
+int DGSetProgram(DGConfig *config, const char *path, const char *source, size_t length) {
+    return Guard(-1, [&] {
+        config->config.setProgram(path, std::string(source, length));
+        return 0;
+    });
+}
+
+DGGame *DGCreateGame(const DGConfig *config) {
+    return Guard<DGGame *>(nullptr, [&] {
+        std::unique_ptr<DGGame> game(new DGGame {config->config, nullptr, RandomState()});
+        
+        WithRandom(game.get(), [&game] {
+            game->game.reset(new Game(game->config));
+        });
+        
+        auto seed = game->game->getMoveSeed();
+        
+        game->random.state  = seed;
+        game->random.seeded = seed != 0;
+        
+        return game.release();
+    });
+}
+
+void DGDestroyGame(DGGame *game) {
+    delete game;
+}
+
+int64_t DGStep(DGGame *game, int64_t moves) {
+    return Guard<int64_t>(-1, [&] {
+        return WithRandom(game, [&] {
+            auto &g = *game->game;
+            
+            int64_t start = g.getMove(), left = game->config.getMaxMoves() - start;
+            
+            g.step(static_cast<int>(std::max<int64_t>(0, std::min(moves, left))));
+            
+            return g.getMove() - start;
+        });
+    });
+}
+
+int64_t DGGetMove(const DGGame *game) {
+    return game->game->getMove();
+}
+
+DGEnding DGGetEnding(const DGGame *game) {
+    switch (game->game->getEnding()) {
+        case Game::Ending::Elimination:
+            return DG_ENDING_ELIMINATION;
+        case Game::Ending::Cycle:
+            return DG_ENDING_CYCLE;
+        case Game::Ending::SteadyState:
+            return DG_ENDING_STEADY_STATE;
+        default:
+            return DG_ENDING_NONE;
+    }
+}
+
+const char *DGGetWinner(const DGGame *game) {
+    auto &winner = game->game->getWinner();
+    return winner.empty() ? nullptr : winner.c_str();
+}
+
+unsigned DGGetLeagueCount(const DGGame *game) {
+    return static_cast<unsigned>(game->game->getLeagues().size());
+}
+
+// Throws for a league the game doesn't have.
+static const League &GetLeague(const DGGame *game, unsigned league) {
+    auto &leagues = game->game->getLeagues();
+    
+    if (league >= leagues.size())
+        throw std::out_of_range("No league " + std::to_string(league) + ".");
+    
+    return leagues[league];
+}
+
+const char *DGGetLeagueName(const DGGame *game, unsigned league) {
+    return Guard<const char *>(nullptr, [&] {
+        return GetLeague(game, league).getName().c_str();
+    });
+}
+
+int DGIsLeagueActive(const DGGame *game, unsigned league) {
+    return Guard(0, [&] {
+        GetLeague(game, league);
+        
+        for (auto id : game->game->getActiveLeagues())
+            if (id == league)
+                return 1;
+        
+        return 0;
+    });
+}
+
+uint64_t DGGetBiomass(const DGGame *game, unsigned league) {
+    return Guard<uint64_t>(0, [&] {
+        return GetLeague(game, league).getTotalBiomass();
+    });
+}
+
+size_t DGGetPopulation(const DGGame *game, unsigned league) {
+    return Guard<size_t>(0, [&] {
+        return GetLeague(game, league).getPopulation();
+    });
+}
+
+const unsigned *DGGetBoard(const DGGame *game, int *columns, int *rows) {
+    if (columns)
+        *columns = game->config.getColumnNumber();
+    
+    if (rows)
+        *rows = game->config.getRowNumber();
+    
+    return game->game->getScreen().data();
+}
+
+int DGGetSpriteLeague(const DGGame *game, unsigned sprite) {
+    auto &sprites = game->game->getSprites();
+    
+    if (sprite == 0 || sprite >= sprites.size())
+        return -1;
+    
+    return static_cast<int>(sprites[sprite].league);
+}
+
+size_t DGSnapshot(const DGGame *game, DGUnit *units, size_t capacity) {
+    std::size_t count = 0;
+    
+    for (auto &league : game->game->getLeagues()) {
+        for (auto &unit : league.units) {
+            if (unit.isDead())
+                continue;
+            
+            if (units && count < capacity) {
+                units[count] = {
+                    unit.getPosition().getX(), unit.getPosition().getY(),
+                    unit.getWeight(),
+                    static_cast<int>(unit.getDirection()),
+                    league.getID(),
+                    unit.getSpriteID()
+                };
+            }
+            
+            count++;
+        }
+    }
+    
+    return count;
+}
+
+uint64_t DGHashBoard(const DGGame *game) {
+    return game->game->hashBoard();
+}
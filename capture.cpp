@@ -0,0 +1,139 @@
+#include "capture.hpp"
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+
+FrameCapture::Format FrameCapture::parseFormat(const std::string &name) {
+    if (name == "y4m")
+        return Format::Y4M;
+    
+    if (name == "rgb")
+        return Format::RGB;
+    
+    throw std::invalid_argument("Unknown capture format: '" + name + "'.");
+}
+
+FrameCapture::FrameCapture(
+    const UIDisplay &display,
+    const std::string &path,
+    Format format,
+    int frameRate,
+    std::size_t queueSize
+) : format(format), frameRate(frameRate > 0 ? frameRate : 30), queue(queueSize) {
+    columnNumber = display.getColumnNumber();
+    rowNumber    = display.getRowNumber();
+    
+    tileWidth  = std::max(display.getSpriteWidth(),  1);
+    tileHeight = std::max(display.getSpriteHeight(), 1);
+    
+    frameWidth  = columnNumber * tileWidth;
+    frameHeight = rowNumber    * tileHeight;
+    
+    // Tiles are prepared up front so that the encoder never touches SDL.
+    auto &sprites = display.getSprites();
+    
+    tiles.resize(sprites.size());
+    for (std::size_t i = 0; i < sprites.size(); i++)
+        sprites[i].rasterize(tiles[i], tileWidth, tileHeight);
+    
+    if (path == "-") {
+        out = stdout;
+        closeOut = false;
+    } else {
+        if (!(out = std::fopen(path.c_str(), "wb")))
+            throw FileError(path.c_str());
+        
+        closeOut = true;
+    }
+    
+    if (format == Format::Y4M)
+        std::fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", frameWidth, frameHeight, this->frameRate);
+    
+    encoder = std::thread([this] {encode();});
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+}
+
+void FrameCapture::submit(const std::vector<SpriteID> &screen, bool wait) {
+    auto snapshot = screen;
+    
+    if (!(wait ? queue.push(std::move(snapshot)) : queue.tryPush(std::move(snapshot))))
+        dropped++;
+}
+
+void FrameCapture::finish() {
+    if (!encoder.joinable())
+        return;
+    
+    queue.close();
+    encoder.join();
+    
+    std::fflush(out);
+    
+    if (closeOut)
+        std::fclose(out);
+    
+    if (dropped)
+        std::cerr << "Capture: " << dropped << " frame(s) dropped, the encoder could not keep up.\n";
+}
+
+void FrameCapture::encode() {
+    std::vector<SpriteID> screen;
+    std::vector<std::uint8_t> rgb, planes;
+    
+    while (queue.pop(screen)) {
+        rasterize(screen, rgb);
+        write(rgb, planes);
+    }
+}
+
+void FrameCapture::rasterize(const std::vector<SpriteID> &screen, std::vector<std::uint8_t> &rgb) const {
+    const std::size_t stride = frameWidth * 3;
+    const std::size_t span   = tileWidth  * 3;
+    
+    rgb.resize(stride * frameHeight);
+    
+    for (int row = 0; row < rowNumber; row++) {
+        for (int column = 0; column < columnNumber; column++) {
+            auto &tile = tiles[screen[row * columnNumber + column]];
+            auto dst   = &rgb[row * tileHeight * stride + column * span];
+            
+            for (int y = 0; y < tileHeight; y++)
+                std::copy_n(&tile[y * span], span, dst + y * stride);
+        }
+    }
+}
+
+void FrameCapture::write(const std::vector<std::uint8_t> &rgb, std::vector<std::uint8_t> &planes) {
+    switch (format) {
+        case Format::RGB:
+            std::fwrite(rgb.data(), 1, rgb.size(), out);
+            break;
+        case Format::Y4M: {
+            // BT.601 studio swing, one full-resolution plane per component.
+            const std::size_t n = rgb.size() / 3;
+            
+            planes.resize(n * 3);
+            
+            auto Y = &planes[0], U = &planes[n], V = &planes[2 * n];
+            
+            for (std::size_t i = 0; i < n; i++) {
+                int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+                
+                Y[i] = (( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16;
+                U[i] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+                V[i] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+            }
+            
+            std::fputs("FRAME\n", out);
+            std::fwrite(planes.data(), 1, planes.size(), out);
+            
+            break;
+        }
+    }
+    
+    written++;
+}
@@ -0,0 +1,78 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include "ui.hpp"
+#include "util.hpp"
+
+
+/*
+ * FrameCapture.
+ *
+ * Rasterizes board snapshots with the sprites of a display and streams
+ * them as Y4M (4:4:4) or raw RGB24 frames. Snapshots are taken on the
+ * simulation thread and handed to an encoder thread through a bounded
+ * queue; when the encoder falls behind, snapshots are dropped rather than
+ * stalling the simulation.
+ */
+
+class FrameCapture {
+public:
+    enum class Format {
+        Y4M,
+        RGB
+    };
+    
+    static Format parseFormat(const std::string &name);
+    
+    FrameCapture(
+        const UIDisplay &display,
+        const std::string &path,
+        Format format,
+        int frameRate = 30,
+        std::size_t queueSize = 64
+    );
+    ~FrameCapture();
+    
+    int getFrameWidth()  const noexcept {return frameWidth;}
+    int getFrameHeight() const noexcept {return frameHeight;}
+    
+    // Only a waiting submit may block the caller, e.g. for the last frame.
+    void submit(const std::vector<SpriteID> &screen, bool wait = false);
+    void finish();
+    
+    std::size_t getWrittenFrames() const noexcept {return written;}
+    std::size_t getDroppedFrames() const noexcept {return dropped;}
+    
+private:
+    Format format;
+    int    frameRate;
+    
+    int columnNumber, rowNumber;
+    int tileWidth, tileHeight;
+    int frameWidth, frameHeight;
+    
+    // One RGB24 tile per registered sprite.
+    std::vector<std::vector<std::uint8_t>> tiles;
+    
+    std::FILE *out;
+    bool closeOut;
+    
+    BoundedQueue<std::vector<SpriteID>> queue;
+    std::thread encoder;
+    
+    std::atomic<std::size_t> written{0}, dropped{0};
+    
+    void encode();
+    void rasterize(const std::vector<SpriteID> &screen, std::vector<std::uint8_t> &rgb) const;
+    void write(const std::vector<std::uint8_t> &rgb, std::vector<std::uint8_t> &planes);
+};
+
+
+#endif
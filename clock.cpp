@@ -0,0 +1,120 @@
+#include "clock.hpp"
+#include <algorithm>
+
+
+typedef std::chrono::duration<double> Seconds;
+
+// When throttled, bursts are sized so that the clock wakes up about this often.
+static const Seconds burstPeriod(0.01);
+
+// Unthrottled bursts only exist so that the caller can look around now and then.
+static const std::size_t unlimitedBurst = 1024;
+
+// Falling further behind than this is forgotten instead of caught up with.
+static const Seconds maxLag(0.1);
+
+static const Seconds sampleWindow(0.5);
+
+
+SimClock::SimClock(Mode mode, double rate) : mode(mode), rate(rate) {
+    if (mode != Mode::Unlimited && rate <= 0)
+        this->mode = Mode::Unlimited;
+    
+    deadline = sampleStart = Clock::now();
+}
+
+double SimClock::getRate() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rate;
+}
+
+std::size_t SimClock::beginBurst() {
+    if (fastForward)
+        return unlimitedBurst;
+    
+    switch (mode) {
+        case Mode::Unlimited:
+            return unlimitedBurst;
+        case Mode::PerSecond: {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::max<std::size_t>(1, rate * burstPeriod.count());
+        }
+        case Mode::PerFrame: {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] {return stopped || fastForward || pendingFrames;});
+            
+            if (pendingFrames)
+                pendingFrames--;
+            
+            return std::max<std::size_t>(1, rate);
+        }
+    }
+    
+    return 1;
+}
+
+bool SimClock::endBurst(std::size_t moves) {
+    auto now = Clock::now();
+    
+    if (mode == Mode::PerSecond && !fastForward) {
+        std::unique_lock<std::mutex> lock(mutex);
+        
+        deadline += std::chrono::duration_cast<Clock::duration>(Seconds(moves / rate));
+        
+        if (now - deadline > maxLag)
+            deadline = now;
+        
+        wakeup.wait_until(lock, deadline, [this] {return stopped || fastForward;});
+        
+        now = Clock::now();
+    } else
+        deadline = now;
+    
+    sampleMoves += moves;
+    
+    Seconds elapsed = now - sampleStart;
+    if (elapsed < sampleWindow)
+        return false;
+    
+    actualRate  = sampleMoves / elapsed.count();
+    sampleMoves = 0;
+    sampleStart = now;
+    
+    return true;
+}
+
+void SimClock::frame() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        // Frames the simulation could not keep up with are not made up for.
+        pendingFrames = 1;
+    }
+    
+    wakeup.notify_all();
+}
+
+void SimClock::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    
+    wakeup.notify_all();
+}
+
+void SimClock::setFastForward(bool enable) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fastForward = enable;
+    }
+    
+    wakeup.notify_all();
+}
+
+void SimClock::scaleRate(double factor) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (mode != Mode::Unlimited)
+        rate = std::min(std::max(rate * factor, 0.01), 1e9);
+}
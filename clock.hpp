@@ -0,0 +1,78 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+
+
+/*
+ * SimClock.
+ *
+ * Paces the simulation in bursts of moves with a single wait per burst.
+ * The target is given either in moves per second or in moves per rendered
+ * frame; a rate of zero runs unthrottled. Fast-forward temporarily lifts
+ * the limit without forgetting the target.
+ */
+
+class SimClock {
+public:
+    typedef std::chrono::steady_clock Clock;
+    
+    enum class Mode {
+        PerSecond,
+        PerFrame,
+        Unlimited
+    };
+    
+    SimClock(Mode mode, double rate);
+    
+    Mode   getMode() const noexcept {return mode;}
+    double getRate() const;
+    
+    // How many moves to run before calling endBurst(); may wait for a frame.
+    std::size_t beginBurst();
+    
+    // Accounts for the moves actually run and waits until the next burst is due.
+    // Returns true when a new measurement of the actual rate is available.
+    bool endBurst(std::size_t moves);
+    
+    // Called by the renderer once per presented frame.
+    void frame();
+    
+    // Wakes up and releases a waiting simulation for good.
+    void stop();
+    
+    void setFastForward(bool enable);
+    void toggleFastForward() {setFastForward(!fastForward);}
+    bool isFastForward() const noexcept {return fastForward;}
+    
+    void scaleRate(double factor);
+    
+    double getActualRate() const noexcept {return actualRate;}
+    
+private:
+    Mode   mode;
+    double rate;
+    
+    std::atomic<bool> fastForward{false};
+    
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    
+    bool stopped = false;
+    std::size_t pendingFrames = 0;
+    
+    Clock::time_point deadline;
+    
+    Clock::time_point sampleStart;
+    std::size_t       sampleMoves = 0;
+    
+    std::atomic<double> actualRate{0};
+};
+
+
+#endif
@@ -5,6 +5,7 @@
 #include <array>
 #include <unordered_map>
 #include <cctype>
+#include <algorithm>
 #include "util.hpp"
 
 
@@ -92,10 +93,80 @@ void Config::parseGame() {
         {"columnNumber",   Json::ValueType::intValue},
         {"rowNumber",      Json::ValueType::intValue},
         {"moveDelay",      Json::ValueType::intValue},
+        {"movesPerSecond", Json::ValueType::nullValue},
+        {"movesPerFrame",  Json::ValueType::intValue},
         {"unitsPerLeague", Json::ValueType::intValue},
         {"leagues",        Json::ValueType::objectValue},
+        {"seed",           Json::ValueType::nullValue},
+        {"maxMoves",       Json::ValueType::intValue},
+        {"quantum",        Json::ValueType::intValue},
+        {"batch",          Json::ValueType::intValue},
+        
+        {"stalemateWindow",    Json::ValueType::intValue},
+        {"stalemateRepeats",   Json::ValueType::intValue},
+        {"stalemateWindows",   Json::ValueType::intValue},
+        {"stalemateTolerance", Json::ValueType::nullValue},
+        {"stalemateShare",     Json::ValueType::nullValue},
+        
+        {"unitOrder",         Json::ValueType::stringValue},
+        {"unitOrderInterval", Json::ValueType::intValue},
+        {"boardTile",         Json::ValueType::intValue},
+        {"placement",         Json::ValueType::stringValue},
+        
+        {"tournament",     Json::ValueType::objectValue},
+        
+        {"headless",         Json::ValueType::booleanValue},
+        {"capture",          Json::ValueType::stringValue},
+        {"captureInterval",  Json::ValueType::intValue},
+        {"captureFormat",    Json::ValueType::stringValue},
+        {"captureFrameRate", Json::ValueType::intValue},
+        {"captureQueue",     Json::ValueType::intValue},
+        
+        {"results",          Json::ValueType::stringValue},
+        {"resultsFormat",    Json::ValueType::stringValue},
+        {"timelineInterval", Json::ValueType::intValue}
     });
     
+    if (root.isMember("movesPerSecond") && !root["movesPerSecond"].isNumeric())
+        throw ConfigError("Member root.movesPerSecond must be a number.");
+    
+    if (root.isMember("seed") && !root["seed"].isUInt64())
+        throw ConfigError("Member root.seed must be a non-negative integer.");
+    
+    for (auto &name : {"stalemateTolerance", "stalemateShare"})
+        if (root.isMember(name) && !root[name].isNumeric())
+            throw ConfigError(std::string("Member root.") + name + " must be a number.");
+    
+    if (getQuantum() < 1 || getBatch() < 1)
+        throw ConfigError("Members root.quantum and root.batch must be positive.");
+    
+    if (getStalemateWindow() < 0)
+        throw ConfigError("Member root.stalemateWindow must not be negative.");
+    
+    if (getStalemateRepeats() < 1 || getStalemateWindows() < 1)
+        throw ConfigError("Members root.stalemateRepeats and root.stalemateWindows must be positive.");
+    
+    if (getUnitOrder() != "insertion" && getUnitOrder() != "morton" && getUnitOrder() != "hilbert")
+        throw ConfigError("Member root.unitOrder must be 'insertion', 'morton' or 'hilbert'.");
+    
+    if (getUnitOrderInterval() < 1)
+        throw ConfigError("Member root.unitOrderInterval must be positive.");
+    
+    if (getPlacement() != "random" && getPlacement() != "scan" && getPlacement() != "spread")
+        throw ConfigError("Member root.placement must be 'random', 'scan' or 'spread'.");
+    
+    if (getBoardTile() < 0 || getBoardTile() > 64 || (getBoardTile() & (getBoardTile() - 1)))
+        throw ConfigError("Member root.boardTile must be 0 or a power of two up to 64.");
+    
+    if (getCaptureFormat() != "y4m" && getCaptureFormat() != "rgb")
+        throw ConfigError("Member root.captureFormat must be either 'y4m' or 'rgb'.");
+    
+    if (getResultsFormat() != "json" && getResultsFormat() != "csv")
+        throw ConfigError("Member root.resultsFormat must be either 'json' or 'csv'.");
+    
+    if (getTimelineInterval() < 0)
+        throw ConfigError("Member root.timelineInterval must not be negative.");
+    
     for (auto &league : root["leagues"].getMemberNames()) {
         const std::string leaguePath = "leagues." + league;
         
@@ -142,29 +213,192 @@ void Config::parseGame() {
         
         leagueInfo[league] = info;
     }
+    
+    if (root.isMember("tournament"))
+        parseTournament();
+}
+
+double Config::getMovesPerSecond() const {
+    if (root.isMember("movesPerSecond"))
+        return root["movesPerSecond"].asDouble();
+    
+    int delay = getMoveDelay();
+    
+    return delay > 0 ? 1000.0 / delay : 0;
+}
+
+static std::vector<UnitStateInfo> parseUnitStates(const std::string &path, const Json::Value &array, std::size_t scripts) {
+    static const std::array<std::string, 4> directions = {"north", "east", "south", "west"};
+    
+    std::vector<UnitStateInfo> states;
+    
+    for (Json::ArrayIndex i = 0; i < array.size(); i++) {
+        const std::string unitPath = path + "[" + std::to_string(i) + "]";
+        const Json::Value &unit = array[i];
+        
+        if (!unit.isObject())
+            throw ConfigError("Member " + unitPath + " must be an object.");
+        
+        checkMembers(unitPath, unit, {
+            {"x",         Json::ValueType::intValue},
+            {"y",         Json::ValueType::intValue},
+            {"weight",    Json::ValueType::intValue},
+            {"direction", Json::ValueType::stringValue},
+            {"script",    Json::ValueType::intValue}
+        });
+        
+        UnitStateInfo state;
+        state.x      = unit.get("x", -1).asInt();
+        state.y      = unit.get("y", -1).asInt();
+        state.weight = unit.get("weight", -1).asInt();
+        state.script = unit.get("script", -1).asInt();
+        
+        if (unit.isMember("direction")) {
+            auto it = std::find(directions.begin(), directions.end(), unit["direction"].asString());
+            
+            if (it == directions.end())
+                throw ConfigError("Member " + unitPath + ".direction must be one of 'north', 'east', 'south' or 'west'.");
+            
+            state.direction = static_cast<int>(it - directions.begin());
+        }
+        
+        if (state.script >= static_cast<int>(scripts))
+            throw ConfigError("Member " + unitPath + ".script is not a script index.");
+        
+        states.push_back(state);
+    }
+    
+    return states;
 }
 
 void Config::parseTest() {
-    abort();
-    /*for (auto &name : root["tests"].getMemberNames()) {
+    checkMembers("root", root, {
+        {"columnNumber", Json::ValueType::intValue},
+        {"rowNumber",    Json::ValueType::intValue},
+        {"seed",         Json::ValueType::nullValue},
+        {"tests",        Json::ValueType::objectValue}
+    });
+    
+    if (root.isMember("seed") && !root["seed"].isUInt64())
+        throw ConfigError("Member root.seed must be a non-negative integer.");
+    
+    for (auto &name : root["tests"].getMemberNames()) {
+        const std::string testPath = "tests." + name;
+        const Json::Value &test = root["tests"][name];
+        
+        checkMembers(testPath, test, {
+            {"columnNumber", Json::ValueType::intValue},
+            {"rowNumber",    Json::ValueType::intValue},
+            {"seed",         Json::ValueType::nullValue},
+            {"steps",        Json::ValueType::intValue},
+            {"scripts",      Json::ValueType::arrayValue},
+            {"source",       Json::ValueType::arrayValue},
+            {"result",       Json::ValueType::arrayValue}
+        });
         
-    }*/
+        if (test.isMember("seed") && !test["seed"].isUInt64())
+            throw ConfigError("Member " + testPath + ".seed must be a non-negative integer.");
+        
+        TestInfo info;
+        info.name         = name;
+        info.columnNumber = test.get("columnNumber", getColumnNumber()).asInt();
+        info.rowNumber    = test.get("rowNumber",    getRowNumber()).asInt();
+        info.steps        = test.get("steps", 1).asInt();
+        info.seed         = test.get("seed", root.get("seed", 1)).asUInt64();
+        
+        for (auto &script : test["scripts"]) {
+            if (!script.isString())
+                throw ConfigError("Member " + testPath + ".scripts must only contain paths.");
+            
+            info.scripts.push_back(script.asString());
+        }
+        
+        if (info.scripts.empty())
+            throw ConfigError("Member " + testPath + ".scripts must not be empty.");
+        
+        info.source = parseUnitStates(testPath + ".source", test["source"], info.scripts.size());
+        info.result = parseUnitStates(testPath + ".result", test["result"], info.scripts.size());
+        
+        tests.push_back(info);
+    }
+}
+
+void Config::parseTournament() {
+    const Json::Value &object = root["tournament"];
+    
+    checkMembers("tournament", object, {
+        {"groupSize", Json::ValueType::intValue},
+        {"games",     Json::ValueType::intValue},
+        {"rating",    Json::ValueType::stringValue},
+        {"k",         Json::ValueType::nullValue},
+        {"sprtElo",   Json::ValueType::nullValue},
+        {"sprtAlpha", Json::ValueType::nullValue},
+        {"sprtBeta",  Json::ValueType::nullValue}
+    });
+    
+    for (auto &name : {"k", "sprtElo", "sprtAlpha", "sprtBeta"})
+        if (object.isMember(name) && !object[name].isNumeric())
+            throw ConfigError(std::string("Member tournament.") + name + " must be a number.");
+    
+    tournament = std::make_shared<TournamentInfo>();
+    
+    auto &info = *tournament;
+    info.groupSize = object.get("groupSize", info.groupSize).asInt();
+    info.games     = object.get("games",     info.games).asInt();
+    info.k         = object.get("k",         info.k).asDouble();
+    info.sprtElo   = object.get("sprtElo",   info.sprtElo).asDouble();
+    info.sprtAlpha = object.get("sprtAlpha", info.sprtAlpha).asDouble();
+    info.sprtBeta  = object.get("sprtBeta",  info.sprtBeta).asDouble();
+    
+    auto rating = object.get("rating", "elo").asString();
+    
+    if (rating == "elo")
+        info.rating = TournamentInfo::Rating::Elo;
+    else if (rating == "glicko")
+        info.rating = TournamentInfo::Rating::Glicko;
+    else
+        throw ConfigError("Member tournament.rating must be either 'elo' or 'glicko'.");
+    
+    if (info.groupSize < 2 || info.groupSize > static_cast<int>(leagueInfo.size()))
+        throw ConfigError("Member tournament.groupSize must be between 2 and the number of leagues.");
+    
+    if (info.games < 1)
+        throw ConfigError("Member tournament.games must be positive.");
+    
+    if (info.sprtElo < 0)
+        throw ConfigError("Member tournament.sprtElo must not be negative.");
+    
+    if (info.sprtAlpha <= 0 || info.sprtAlpha >= 1 || info.sprtBeta <= 0 || info.sprtBeta >= 1)
+        throw ConfigError("Members tournament.sprtAlpha and tournament.sprtBeta must be between 0 and 1.");
 }
 
 Config::Config(const char *path) {
+    std::string p = path;
+    
+    auto slash = p.rfind('/');
+    if (slash != std::string::npos)
+        directory = slash ? p.substr(0, slash) : "/";
+    
     auto fs = FileOpenIn(path);
     
     Json::Reader reader;
     if (!reader.parse(fs, root))
         throw ConfigError(reader);
     
+    parseRoot();
+}
+
+Config::Config(const Json::Value &root) : root(root) {
+    parseRoot();
+}
+
+void Config::parseRoot() {
     if (!root.isObject())
         throw ConfigError("The root must an object.");
     
-    if (root.isMember("tests")) {
-        checkMembers("root", root, {{"tests", Json::ValueType::objectValue}});
+    if (root.isMember("tests"))
         parseTest();
-    } else
+    else
         parseGame();
 }
 
@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <exception>
 #include <cstdint>
 #include <json/json.h>
@@ -15,6 +16,9 @@ class  ConfigError;
 struct LeagueInfo;
 struct UnitKindInfo;
 struct SpriteInfo;
+struct TestInfo;
+struct UnitStateInfo;
+struct TournamentInfo;
 
 /*
  * Config.
@@ -25,15 +29,27 @@ private:
     Json::Value root;
     
     std::unordered_map<std::string, LeagueInfo> leagueInfo;
+    std::vector<TestInfo> tests;
     
+    std::shared_ptr<TournamentInfo> tournament;
+    
+    // Executable sources given in memory, by the path they stand in for.
+    std::unordered_map<std::string, std::string> programs;
+    
+    // Where the file came from, relative paths in it are resolved against this.
+    std::string directory = ".";
+    
+    void parseRoot();
     void parseGame();
     void parseTest();
+    void parseTournament();
     
 public:
     void parse(const char *path);
     
     Config(const char *path);
     Config(const std::string &path) : Config(path.c_str()) {};
+    explicit Config(const Json::Value &root);
     
     
     
@@ -48,12 +64,120 @@ public:
     }
     
     int  getMoveDelay() const    {return root.get("moveDelay", 250).asInt();}
-    void setMoveDelay(int delay) {root["moveDelay"] = delay;}
+    void setMoveDelay(int delay) {
+        root["moveDelay"] = delay;
+        root.removeMember("movesPerSecond");
+        root.removeMember("movesPerFrame");
+    }
+    
+    /*
+     * The simulation rate: movesPerFrame wins over movesPerSecond, which wins
+     * over the older moveDelay. A rate of zero means unlimited.
+     */
+    
+    double getMovesPerSecond() const;
+    void   setMovesPerSecond(double rate) {
+        root["movesPerSecond"] = rate;
+        root.removeMember("movesPerFrame");
+    }
+    
+    int  getMovesPerFrame() const   {return root.get("movesPerFrame", 0).asInt();}
+    void setMovesPerFrame(int rate) {root["movesPerFrame"] = rate;}
     
     int getMaxMoves() const {return root.get("maxMoves", 1000000).asInt();}
     
+    // Moves a unit makes in a row, and units of a league that move before the next league's turn.
+    int  getQuantum() const      {return root.get("quantum", 1).asInt();}
+    void setQuantum(int quantum) {root["quantum"] = quantum;}
+    
+    int  getBatch() const    {return root.get("batch", 1).asInt();}
+    void setBatch(int batch) {root["batch"] = batch;}
+    
+    /*
+     * Ending stalemates early, see Game::step(). A window of zero moves
+     * plays on until one league is left or maxMoves is reached.
+     */
+    
+    int  getStalemateWindow() const    {return root.get("stalemateWindow", 0).asInt();}
+    void setStalemateWindow(int moves) {root["stalemateWindow"] = moves;}
+    
+    int    getStalemateRepeats()   const {return root.get("stalemateRepeats",   3).asInt();}
+    int    getStalemateWindows()   const {return root.get("stalemateWindows",   10).asInt();}
+    double getStalemateTolerance() const {return root.get("stalemateTolerance", 0.001).asDouble();}
+    double getStalemateShare()     const {return root.get("stalemateShare",     0.75).asDouble();}
+    
+    // A non-zero seed makes the game reproducible.
+    std::uint64_t getSeed() const              {return root.get("seed", 0).asUInt64();}
+    void          setSeed(std::uint64_t seed) {root["seed"] = Json::UInt64(seed);}
+    
+    bool isHeadless() const    {return root.get("headless", false).asBool();}
+    void setHeadless(bool set) {root["headless"] = set;}
+    
+    std::string getCapturePath() const           {return root.get("capture", "").asString();}
+    void        setCapturePath(const std::string &path) {root["capture"] = path;}
+    
+    int  getCaptureInterval() const       {return root.get("captureInterval", 1).asInt();}
+    void setCaptureInterval(int interval) {root["captureInterval"] = interval;}
+    
+    std::string getCaptureFormat() const                 {return root.get("captureFormat", "y4m").asString();}
+    void        setCaptureFormat(const std::string &format) {root["captureFormat"] = format;}
+    
+    int getCaptureFrameRate() const {return root.get("captureFrameRate", 30).asInt();}
+    int getCaptureQueue()     const {return root.get("captureQueue",     64).asInt();}
+    
+    // One record per match, see results.hpp.
+    std::string getResultsPath() const           {return root.get("results", "").asString();}
+    void        setResultsPath(const std::string &path) {root["results"] = path;}
+    
+    std::string getResultsFormat() const                 {return root.get("resultsFormat", "json").asString();}
+    void        setResultsFormat(const std::string &format) {root["resultsFormat"] = format;}
+    
+    // The biomass and population of every league is sampled every so many moves, never if 0.
+    int  getTimelineInterval() const       {return root.get("timelineInterval", 0).asInt();}
+    void setTimelineInterval(int interval) {root["timelineInterval"] = interval;}
+    
+    /*
+     * A unit kind's executable is read from '<league directory>/<exec>'
+     * unless a source has been set for that path here.
+     */
+    
+    void setProgram(const std::string &path, const std::string &source) {programs[path] = source;}
+    
+    const std::string *findProgram(const std::string &path) const {
+        auto it = programs.find(path);
+        return it != programs.end() ? &it->second : nullptr;
+    }
+    
+    /*
+     * Every 'unitOrderInterval' rounds, the units of a league can be sorted
+     * along a 'morton' or 'hilbert' curve over their cells instead of being
+     * kept in the order they were born in ('insertion').
+     */
+    
+    std::string getUnitOrder()         const {return root.get("unitOrder", "insertion").asString();}
+    int         getUnitOrderInterval() const {return root.get("unitOrderInterval", 1).asInt();}
+    
+    // Store the board in square tiles of this many cells a side, see BoardLayout; 0 stores it by rows.
+    int getBoardTile() const {return root.get("boardTile", 0).asInt();}
+    
+    // 'random', or 'scan' or 'spread' for the same start every time, see Game::Placement.
+    std::string getPlacement() const {return root.get("placement", "random").asString();}
+    
     int getUnitsPerLeague() const noexcept {return root.get("unitsPerLeague", 10).asInt();}
     const std::unordered_map<std::string, LeagueInfo> &getLeagueInfo() const noexcept {return leagueInfo;}
+    
+    // A config with 'tests' describes scenario tests instead of a game.
+    bool isTestSuite() const noexcept {return root.isMember("tests");}
+    const std::vector<TestInfo> &getTests() const noexcept {return tests;}
+    
+    // A config with 'tournament' plays its leagues against each other.
+    bool isTournament() const noexcept {return root.isMember("tournament");}
+    const TournamentInfo &getTournament() const noexcept {return *tournament;}
+    
+    const std::string &getDirectory() const noexcept {return directory;}
+    
+    // As parsed, with the overrides set since.
+    const Json::Value &getRoot() const noexcept {return root;}
 };
 
 /*
@@ -90,6 +214,58 @@ struct UnitKindInfo {
     std::shared_ptr<SpriteInfo> sprite;
 };
 
+/*
+ * TestInfo.
+ *
+ * Units start as in 'source', the scripts run for 'steps' moves and the
+ * units left, in script order and then in league order, must match
+ * 'result'. Unit state fields that are left out are random in 'source'
+ * and not checked in 'result'.
+ */
+
+struct UnitStateInfo {
+    int  x = -1, y = -1;
+    long weight = -1;
+    int  direction = -1;  // Unit::Direction
+    int  script = -1;     // index into TestInfo::scripts
+};
+
+struct TestInfo {
+    std::string name;
+    
+    int columnNumber, rowNumber;
+    int steps;
+    std::uint64_t seed;
+    
+    std::vector<std::string>   scripts;
+    std::vector<UnitStateInfo> source, result;
+};
+
+/*
+ * TournamentInfo.
+ *
+ * Every group of 'groupSize' leagues plays up to 'games' seeded games. A
+ * group stops early once, for each pair of leagues in it, the sequential
+ * probability ratio test has decided which one is 'sprtElo' Elo points
+ * stronger, with error rates 'sprtAlpha' and 'sprtBeta'. A 'sprtElo' of
+ * zero plays every game.
+ */
+
+struct TournamentInfo {
+    enum class Rating {
+        Elo,
+        Glicko
+    };
+    
+    int groupSize = 2;
+    int games     = 100;
+    
+    Rating rating = Rating::Elo;
+    double k      = 16;  // the Elo K-factor
+    
+    double sprtElo = 50, sprtAlpha = 0.05, sprtBeta = 0.05;
+};
+
 /*
  * SpriteInfo.
  */
@@ -0,0 +1,99 @@
+#ifndef DEATHGAME_H
+#define DEATHGAME_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * libdeathgame.
+ *
+ * The engine without a window: games are built from a config in memory,
+ * stepped by the caller and read back without copying. Functions that can
+ * fail return NULL or -1 and leave a message for DGGetError().
+ *
+ * A game may be used from any thread, but from one at a time. Every game
+ * draws from its own random number stream, so a seeded game plays the same
+ * as 'deathgame -headless' however calls to several games are interleaved.
+ */
+
+typedef struct DGConfig DGConfig;
+typedef struct DGGame   DGGame;
+
+typedef enum {
+    DG_ENDING_NONE,          /* still running, or stopped at maxMoves */
+    DG_ENDING_ELIMINATION,   /* at most one league is left */
+    DG_ENDING_CYCLE,         /* the board keeps coming back to the same state */
+    DG_ENDING_STEADY_STATE   /* the biomass shares have stopped changing */
+} DGEnding;
+
+typedef struct {
+    int      x, y;
+    long     weight;
+    int      direction;  /* 0 north, 1 east, 2 south, 3 west */
+    unsigned league;
+    unsigned sprite;
+} DGUnit;
+
+/* The last error on the calling thread, "" if there was none. */
+const char *DGGetError(void);
+
+/*
+ * Configs.
+ */
+
+/* Parses the contents of a config.json; league directories are relative to the working directory. */
+DGConfig *DGCreateConfig(const char *json, size_t length);
+void      DGDestroyConfig(DGConfig *config);
+
+/* Gives the source for the executable that would be read from 'path', i.e. "<league directory>/<exec>". */
+int DGSetProgram(DGConfig *config, const char *path, const char *source, size_t length);
+
+/*
+ * Games.
+ */
+
+/* Loads the executables and places the units; the config may be destroyed afterwards. */
+DGGame *DGCreateGame(const DGConfig *config);
+void    DGDestroyGame(DGGame *game);
+
+/* Plays up to 'moves' moves and returns how many were played, fewer once the game is over or at maxMoves. */
+int64_t DGStep(DGGame *game, int64_t moves);
+
+int64_t     DGGetMove(const DGGame *game);
+DGEnding    DGGetEnding(const DGGame *game);
+const char *DGGetWinner(const DGGame *game);  /* NULL for a draw or while running */
+
+/* Leagues are numbered from 0, eliminated ones included; for any other number these fail with NULL or 0. */
+unsigned    DGGetLeagueCount(const DGGame *game);
+const char *DGGetLeagueName(const DGGame *game, unsigned league);
+int         DGIsLeagueActive(const DGGame *game, unsigned league);
+uint64_t    DGGetBiomass(const DGGame *game, unsigned league);
+size_t      DGGetPopulation(const DGGame *game, unsigned league);
+
+/*
+ * The sprite id of every cell, row by row; 0 is empty, as are the first
+ * row and column. Points into the game and changes as it is stepped.
+ */
+const unsigned *DGGetBoard(const DGGame *game, int *columns, int *rows);
+
+/* The league a sprite id belongs to, -1 for the empty cell. */
+int DGGetSpriteLeague(const DGGame *game, unsigned sprite);
+
+/* Copies up to 'capacity' living units and returns how many there are; 'units' may be NULL to count them. */
+size_t DGSnapshot(const DGGame *game, DGUnit *units, size_t capacity);
+
+/* The hash 'deathgame-macro' checks reproduced games with. */
+uint64_t DGHashBoard(const DGGame *game);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
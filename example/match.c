@@ -0,0 +1,63 @@
+/*
+ * Plays bees against chickens with libdeathgame, the programs given in
+ * memory, once for every seed from 1 to the argument (default 10).
+ *
+ * $ make example/match && ./example/match 100
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../deathgame.h"
+
+
+// A printf format for the seed.
+static const char config[] =
+    "{"
+    "    \"columnNumber\": 64, \"rowNumber\": 64, \"unitsPerLeague\": 20,"
+    "    \"maxMoves\": 200000, \"stalemateWindow\": 1000, \"seed\": %d,"
+    "    \"leagues\": {"
+    "        \"bees\":     {\"unitKinds\": {\"start\": {\"sprite\": \"#ffcc00\"}}},"
+    "        \"chickens\": {\"startKind\": \"chick\", \"unitKinds\": {\"chick\": {\"sprite\": \"#ffffff\"}}}"
+    "    }"
+    "}";
+
+static const char bees[]     = "turn r\ngo\neat\nj 0\n";
+static const char chickens[] = "eat\njl 12 0\nclon\nj 0\n";
+
+int main(int argc, char **argv) {
+    int games = argc > 1 ? atoi(argv[1]) : 10;
+    
+    for (int seed = 1; seed <= games; seed++) {
+        char json[sizeof config + 16];
+        snprintf(json, sizeof json, config, seed);
+        
+        DGConfig *cfg = DGCreateConfig(json, strlen(json));
+        
+        if (!cfg || DGSetProgram(cfg, "bees/start.dasm", bees, strlen(bees)) ||
+            DGSetProgram(cfg, "chickens/chick.dasm", chickens, strlen(chickens))) {
+            fprintf(stderr, "%s\n", DGGetError());
+            return 1;
+        }
+        
+        DGGame *game = DGCreateGame(cfg);
+        DGDestroyConfig(cfg);
+        
+        if (!game || DGStep(game, INT64_MAX) < 0) {
+            fprintf(stderr, "%s\n", DGGetError());
+            return 1;
+        }
+        
+        const char *winner = DGGetWinner(game);
+        printf("seed %d: %s after %lld moves,", seed, winner ? winner : "no winner", (long long)DGGetMove(game));
+        
+        for (unsigned i = 0; i < DGGetLeagueCount(game); i++)
+            printf(" %s %llu", DGGetLeagueName(game, i), (unsigned long long)DGGetBiomass(game, i));
+        
+        printf(", board %016llx\n", (unsigned long long)DGHashBoard(game));
+        
+        DGDestroyGame(game);
+    }
+    
+    return 0;
+}
@@ -1,181 +1,255 @@
 #include "executable.hpp"
-#include <unordered_map>
-#include <functional>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <cstring>
 #include "util.hpp"
 
-#include <iostream>
 
+/*
+ * Mnemonics.
+ *
+ * Looked up by a hash of the first and last characters and the length,
+ * which has no collisions among them, followed by a single comparison.
+ */
 
-Executable::Executable(const std::string &path) {
-    auto in = FileOpenIn(path);
+namespace {
+
+enum class Operands {
+    None,      // clon, left, right, back
+    CountOrR,  // eat, go: optional count 2..99 or r, 1 if left out
+    Count,     // str: optional count, 1 if left out
+    R,         // turn: r
+    NumLine,   // jg, jl: number, line
+    Line       // j, je: line
+};
+
+struct Mnemonic {
+    const char *name;
+    std::size_t length;
+    Executable::Word opcode;
+    Operands operands;
+};
+
+inline unsigned mnemonicHash(const char *s, std::size_t length) {
+    return (s[0] + 2 * s[length - 1] + 8 * length) & 31;
+}
+
+const std::array<Mnemonic, 32> &mnemonicTable() {
+    static const std::array<Mnemonic, 32> table = [] {
+        static const Mnemonic mnemonics[] = {
+            {"eat",   3, Executable::InsnEat,   Operands::CountOrR},
+            {"go",    2, Executable::InsnGo,    Operands::CountOrR},
+            {"clon",  4, Executable::InsnClon,  Operands::None},
+            {"str",   3, Executable::InsnStr,   Operands::Count},
+            {"left",  4, Executable::InsnLeft,  Operands::None},
+            {"right", 5, Executable::InsnRight, Operands::None},
+            {"back",  4, Executable::InsnBack,  Operands::None},
+            {"turn",  4, Executable::InsnTurn,  Operands::R},
+            {"jg",    2, Executable::InsnJG,    Operands::NumLine},
+            {"jl",    2, Executable::InsnJL,    Operands::NumLine},
+            {"j",     1, Executable::InsnJ,     Operands::Line},
+            {"je",    2, Executable::InsnJE,    Operands::Line}
+        };
+        
+        std::array<Mnemonic, 32> table = {};
+        
+        for (auto &m : mnemonics)
+            table[mnemonicHash(m.name, m.length)] = m;
+        
+        return table;
+    }();
     
-    std::vector<std::vector<std::string>> lines;
+    return table;
+}
+
+struct Token {
+    const char *begin = nullptr;
+    std::size_t length = 0;
     
-    std::string line;
-    while (std::getline(in, line)) {
-        lines.resize(lines.size() + 1);
-        
-        std::size_t i = 0;
-        std::size_t d;
-        do {
-            std::string s;
-            d = line.find(' ', i);
-            if (d == s.npos)
-                s = std::string(line, i);
-            else
-                s = std::string(line, i, d - i);
-            
-            if (s.length())
-                lines.back().push_back(s);
-            
-            i = d + 1;
-        } while (d != std::string::npos);
+    bool is(const char *s) const {
+        return length == std::strlen(s) && !std::memcmp(begin, s, length);
     }
+};
+
+bool parseNumber(const Token &token, Executable::Word &value) {
+    if (!token.length)
+        return false;
     
-    int n = 0;
+    std::uint64_t n = 0;
     
-    std::vector<Word> jmp = {0};
-    
-    for (auto &line : lines) {
-        std::unordered_map<std::string, Word> sizes = {
-            {"eat",   2},
-            {"go",    2},
-            {"clon",  1},
-            {"str",   2},
-            {"left",  1},
-            {"right", 1},
-            {"back",  1},
-            {"turn",  1},
-            {"jg",    3},
-            {"jl",    3},
-            {"j",     2},
-            {"je",    2}
-        };
+    for (std::size_t i = 0; i < token.length; i++) {
+        unsigned digit = static_cast<unsigned char>(token.begin[i]) - '0';
         
-        try {
-            jmp.push_back(jmp.back() + sizes.at(line.front()));
-        } catch (const std::logic_error &) {
-            throw ExecutableError(path, n);
-        }
+        if (digit > 9 || (n = n * 10 + digit) > std::numeric_limits<Executable::Word>::max())
+            return false;
     }
     
-    n = 0;
+    value = static_cast<Executable::Word>(n);
     
-    for (auto &insn : lines) {
-        auto parseOpN = [this, insn, path, n] {
-            switch (insn.size()) {
-                case 1:
-                    bytecode.push_back(1);
-                    break;
-                case 2:
-                    try {
-                        bytecode.push_back((Word)std::stoul(insn[1]));
-                        break;
-                    } catch (const std::invalid_argument &) {}
-                default:
-                    throw ExecutableError(path, n);
-            }
-        };
-        
-        auto parseOpR = [this, insn, path, n] {
-            if (insn.size() != 2 || insn[1] != "r")
-                throw ExecutableError(path, n);
-        };
+    return true;
+}
+
+}
+
+static std::atomic<std::uint32_t> nextID{1};
+
+Executable::Executable(const std::string &path) : id(nextID++), path(path) {
+    auto in = FileOpenIn(path, true);
+    
+    in.seekg(0, std::ios::end);
+    std::string source(static_cast<std::size_t>(in.tellg()), '\0');
+    in.seekg(0, std::ios::beg);
+    
+    if (!in.read(&source[0], source.size()))
+        throw FileError(path.c_str());
+    
+    assemble(source.data(), source.data() + source.size());
+}
+
+Executable Executable::fromSource(const std::string &source, const std::string &name) {
+    Executable exec;
+    exec.id   = nextID++;
+    exec.path = name;
+    
+    exec.assemble(source.data(), source.data() + source.size());
+    
+    return exec;
+}
+
+/*
+ * A single pass over the source: lines are split into tokens in place and
+ * jump operands, which are line numbers, are patched with addresses once
+ * every line has one.
+ */
+
+void Executable::assemble(const char *begin, const char *end) {
+    auto &table = mnemonicTable();
+    
+    struct Fixup {
+        std::size_t at;
+        Word line;
+        int source;
+    };
+    
+    std::vector<Word>  addresses;
+    std::vector<Fixup> fixups;
+    
+    bytecode.reserve((end - begin) / 3);
+    
+    int n = 0;
+    
+    for (auto p = begin; p < end; n++) {
+        auto eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
         
-        auto parseOpNR = [this, insn, path, n] {
-            switch (insn.size()) {
-                case 1:
-                    bytecode.push_back(1);
-                    break;
-                case 2:
-                    if (insn[1] == "r")
-                        bytecode.push_back(0);
-                    else {
-                        try {
-                            bytecode.push_back(static_cast<Word>(std::stoul(insn[1])));
-                        } catch (const std::invalid_argument &) {
-                            throw ExecutableError(path, n);
-                        }
-                        
-                        if (bytecode.back() < 2 || bytecode.back() > 99)
-                            throw ExecutableError(path, n);
-                    }
-                    
-                    break;
-                default:
-                    throw ExecutableError(path, n);
-            }
-        };
+        // The mnemonic and up to two operands; a fourth token is an error.
+        Token tokens[4];
+        std::size_t count = 0;
         
-        auto parseOpNN = [this, insn, path, n] {
-            try {
-                bytecode.push_back(static_cast<Word>(std::stoul(insn.at(1))));
-                bytecode.push_back(static_cast<Word>(std::stoul(insn.at(2))));
-            } catch (const std::logic_error &) {
-                throw ExecutableError(path, n);
+        while (p < eol) {
+            if (*p == ' ') {
+                p++;
+                continue;
             }
-        };
-        
-        auto parseOpNone = [this, insn, path, n] {
-            if (insn.size() != 1)
-                throw ExecutableError(path, n);
-        };
-        
-        auto leaveJumpAddr = [this, jmp, path, n](Word pc) {
-            if (pc >= jmp.size())
+            
+            auto token = p;
+            while (p < eol && *p != ' ')
+                p++;
+            
+            if (count == 4)
                 throw ExecutableError(path, n);
             
-            bytecode.push_back(jmp[pc]);
-        };
+            tokens[count].begin  = token;
+            tokens[count].length = p - token;
+            count++;
+        }
         
-        auto parseOpNJ = [this, insn, path, n, leaveJumpAddr] {
-            try {
-                bytecode.push_back((Word)std::stoul(insn.at(1)));
-                leaveJumpAddr((Word)std::stoul(insn[2]));
-            } catch (const std::logic_error &) {
-                throw ExecutableError(path, n);
-            }
-        };
+        p = eol + 1;
         
-        auto parseOpJ = [this, insn, path, n, leaveJumpAddr] {
-            try {
-                leaveJumpAddr((Word)std::stoul(insn.at(1)));
-            } catch (const std::logic_error &) {
-                throw ExecutableError(path, n);
-            }
-        };
+        if (!count)
+            throw ExecutableError(path, n);
         
-        std::unordered_map<std::string, std::function<void()>> handle = {
-#define INSN(n, i, o) \
-{#n, [this, parseOp ## o] {\
-    bytecode.push_back(Insn ## i);\
-    parseOp ## o();\
-}}
-        
-            INSN(eat,   Eat,   NR),
-            INSN(go,    Go,    NR),
-            INSN(clon,  Clon,  None),
-            INSN(str,   Str,   N),
-            INSN(left,  Left,  None),
-            INSN(right, Right, None),
-            INSN(back,  Back,  None),
-            INSN(turn,  Turn,  R),
-            INSN(jg,    JG,    NJ),
-            INSN(jl,    JL,    NJ),
-            INSN(j,     J,     J),
-            INSN(je,    JE,    J)
-            
-#undef INSN
-        };
+        auto &m = table[mnemonicHash(tokens[0].begin, tokens[0].length)];
         
-        try {
-            handle.at(insn[0])();
-        } catch (const std::out_of_range &) {
+        if (!m.name || m.length != tokens[0].length || std::memcmp(m.name, tokens[0].begin, m.length))
             throw ExecutableError(path, n);
+        
+        addresses.push_back(static_cast<Word>(bytecode.size()));
+        bytecode.push_back(m.opcode);
+        
+        const std::size_t operands = count - 1;
+        Word value;
+        
+        switch (m.operands) {
+            case Operands::None:
+                if (operands)
+                    throw ExecutableError(path, n);
+                
+                break;
+            case Operands::CountOrR:
+                if (!operands)
+                    bytecode.push_back(1);
+                else if (operands == 1 && tokens[1].is("r"))
+                    bytecode.push_back(0);
+                else if (operands == 1 && parseNumber(tokens[1], value) && value >= 2 && value <= 99)
+                    bytecode.push_back(value);
+                else
+                    throw ExecutableError(path, n);
+                
+                break;
+            case Operands::Count:
+                if (!operands)
+                    bytecode.push_back(1);
+                else if (operands == 1 && parseNumber(tokens[1], value))
+                    bytecode.push_back(value);
+                else
+                    throw ExecutableError(path, n);
+                
+                break;
+            case Operands::R:
+                if (operands != 1 || !tokens[1].is("r"))
+                    throw ExecutableError(path, n);
+                
+                break;
+            case Operands::NumLine:
+                if (operands != 2 || !parseNumber(tokens[1], value))
+                    throw ExecutableError(path, n);
+                
+                bytecode.push_back(value);
+                
+                if (!parseNumber(tokens[2], value))
+                    throw ExecutableError(path, n);
+                
+                fixups.push_back({bytecode.size(), value, n});
+                bytecode.push_back(0);
+                
+                break;
+            case Operands::Line:
+                if (operands != 1 || !parseNumber(tokens[1], value))
+                    throw ExecutableError(path, n);
+                
+                fixups.push_back({bytecode.size(), value, n});
+                bytecode.push_back(0);
+                
+                break;
         }
         
-        n++;
+        lines.resize(bytecode.size(), n);
     }
+    
+    // Jumping to the line after the last one is allowed, it wraps around.
+    addresses.push_back(static_cast<Word>(bytecode.size()));
+    
+    for (auto &fixup : fixups) {
+        if (fixup.line >= addresses.size())
+            throw ExecutableError(path, fixup.source);
+        
+        bytecode[fixup.at] = addresses[fixup.line];
+    }
+    
+    bytecode.shrink_to_fit();
 }
 
 ExecutableError::ExecutableError(const std::string &path, int line) {
@@ -205,3 +279,42 @@ const std::string &DisasmOpcode(Executable::Word opcode) {
     
     return mnemonics[opcode];
 }
+
+// Beyond this many executables the cache starts over, as with the server's configs.
+static const std::size_t maxCachedExecutables = 256;
+
+Executable ExecutableCache::get(const std::string &path, const std::string *source) {
+    // A source is keyed with its name, which errors and profiles report it under.
+    auto key   = source ? '\0' + path + '\0' + *source : path;
+    auto stamp = source ? std::string() : FileStamp(path.c_str());
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        auto it = executables.find(key);
+        if (it != executables.end() && it->second.stamp == stamp)
+            return it->second.exec;
+    }
+    
+    // Assembled unlocked; if another thread gets there first with the same file, its copy is kept.
+    auto exec = source ? Executable::fromSource(*source, path) : Executable(path);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (executables.size() >= maxCachedExecutables)
+        executables.clear();
+    
+    auto it = executables.find(key);
+    
+    if (it == executables.end())
+        it = executables.emplace(std::move(key), Entry {std::move(stamp), std::move(exec)}).first;
+    else if (it->second.stamp != stamp)
+        it->second = Entry {std::move(stamp), std::move(exec)};
+    
+    return it->second.exec;
+}
+
+std::size_t ExecutableCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return executables.size();
+}
@@ -4,6 +4,8 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <mutex>
 #include <fstream>
 #include <cstdint>
 #include <exception>
@@ -41,12 +43,56 @@ public:
     Executable() {}
     Executable(const std::string &path);
     
+    // Assembles a program held in memory; 'name' stands in for the path in errors.
+    static Executable fromSource(const std::string &source, const std::string &name = "(source)");
+    
     const Bytecode &getBytecode() const {return bytecode;}
     std::size_t size() const {return bytecode.size();}
     Word operator[](std::size_t i) const {return bytecode[i];}
     
+    // Unique per parsed program and shared by its copies, 0 for none.
+    std::uint32_t getID() const noexcept {return id;}
+    
+    const std::string &getPath() const noexcept {return path;}
+    
+    // The source line, as counted by jumps, of the instruction at a pc.
+    int getLine(Word pc) const {return lines[pc];}
+    const std::vector<int> &getLines() const noexcept {return lines;}
+    
 private:
     Bytecode bytecode;
+    
+    void assemble(const char *begin, const char *end);
+    
+    std::uint32_t id = 0;
+    std::string path;
+    std::vector<int> lines;
+};
+
+/*
+ * ExecutableCache.
+ *
+ * Assembled programs kept for processes that build many games from the
+ * same ones. A file is assembled again once its FileStamp() has changed,
+ * so that a long-running server plays the program as it is on disk. Safe
+ * to share between threads.
+ */
+
+class ExecutableCache {
+public:
+    // A copy of the executable of 'path', or of 'source' named 'path', assembled on first use.
+    Executable get(const std::string &path, const std::string *source = nullptr);
+    
+    std::size_t size();
+    
+private:
+    struct Entry {
+        std::string stamp;  // of the file, empty for a source
+        Executable  exec;
+    };
+    
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> executables;
 };
 
 /*
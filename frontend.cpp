@@ -0,0 +1,191 @@
+#include "frontend.hpp"
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include "trace.hpp"
+
+
+// Without a window there are no frames to pace by, so a nominal frame rate is assumed.
+static const int headlessFrameRate = 60;
+
+static SimClock::Mode getClockMode(const Config &config) {
+    if (config.getMovesPerFrame() > 0)
+        return config.isHeadless() ? SimClock::Mode::PerSecond : SimClock::Mode::PerFrame;
+    
+    return config.getMovesPerSecond() > 0 ? SimClock::Mode::PerSecond : SimClock::Mode::Unlimited;
+}
+
+static double getClockRate(const Config &config) {
+    if (config.getMovesPerFrame() > 0)
+        return config.getMovesPerFrame() * (config.isHeadless() ? headlessFrameRate : 1);
+    
+    return config.getMovesPerSecond();
+}
+
+// Images are decoded when first drawn.
+static Sprite spriteFromInfo(const std::string &directory, const SpriteInfo *info) {
+    switch (info->getType()) {
+        case SpriteInfo::Type::SquareRGB: {
+            auto rgb = static_cast<const SpriteInfoSquareRGB *>(info);
+            return Sprite(rgb->red, rgb->green, rgb->blue);
+        }
+        case SpriteInfo::Type::ImagePath:
+            auto path = static_cast<const SpriteInfoImagePath *>(info);
+            return Sprite((directory + '/' + *path).c_str());
+    }
+}
+
+GameFrontend::GameFrontend(Game &game)
+: game(game), config(game.getConfig()), display(
+    0, 0, 0,
+    config.getColumnNumber() * config.getSpriteWidth(),
+    config.getRowNumber()    * config.getSpriteHeight(),
+    config.getColumnNumber(), config.getRowNumber(),
+    false, "The Game of Death",
+    config.isHeadless() ? UIDisplay::Output::None : UIDisplay::Output::Window
+), clock(getClockMode(config), getClockRate(config)) {
+    auto &sprites = game.getSprites();
+    
+    for (std::size_t id = 1; id < sprites.size(); id++) {
+        auto &source = sprites[id];
+        
+        if (display.registerSprite(spriteFromInfo(source.leagueInfo->directory, source.kind->sprite.get()), source.league) != id)
+            throw std::logic_error("Sprite ids of the display and the game differ.");
+    }
+    
+    display.showScreen(game.getScreen().data());
+    
+    if (!config.getCapturePath().empty()) {
+        capture.reset(new FrameCapture(
+            display,
+            config.getCapturePath(),
+            FrameCapture::parseFormat(config.getCaptureFormat()),
+            config.getCaptureFrameRate(),
+            config.getCaptureQueue()
+        ));
+    }
+}
+
+GameFrontend::~GameFrontend() {
+    if (thread.joinable())
+        thread.join();
+}
+
+void GameFrontend::run() {
+    int maxMoves = config.getMaxMoves();
+    
+    int captureInterval = std::max(config.getCaptureInterval(), 1);
+    
+    if (capture)
+        capture->submit(game.getScreen());
+    
+    TraceThreadName("sim");
+    
+    bool running = true;
+    
+    while (running && threadCont) {
+        std::size_t burst = clock.beginBurst(), done = 0;
+        
+        {
+            TraceSpan span("burst");
+            
+            while (done < burst && threadCont) {
+                // Up to the next frame to capture, the end of the burst or maxMoves, whichever comes first.
+                int moves = static_cast<int>(std::min<std::size_t>(burst - done, maxMoves - game.getMove()));
+                
+                if (capture)
+                    moves = std::min(moves, captureInterval - game.getMove() % captureInterval);
+                
+                int start = game.getMove();
+                
+                running = game.step(moves);
+                done += game.getMove() - start;
+                
+                if (capture && game.getMove() % captureInterval == 0)
+                    capture->submit(game.getScreen());
+                
+                if (!running)
+                    break;
+                
+                if (game.getMove() == maxMoves) {
+                    running = false;
+                    break;
+                }
+            }
+            
+            display.publish();
+        }
+        
+        if (TraceActive.load(std::memory_order_relaxed))
+            for (auto id : game.getActiveLeagues())
+                TraceCounter("units", id, game.getLeagues()[id].units.size());
+        
+        if (clock.endBurst(done))
+            updateStatus();
+    }
+    
+    if (capture) {
+        // Always end the recording on the final board.
+        if (game.getMove() % captureInterval)
+            capture->submit(game.getScreen(), true);
+        
+        capture->finish();
+    }
+}
+
+void GameFrontend::updateStatus() {
+    if (display.isHeadless())
+        return;
+    
+    std::string status = std::to_string(static_cast<long>(clock.getActualRate() + 0.5)) + " moves/s";
+    
+    if (clock.isFastForward())
+        status += " (fast-forward)";
+    else if (clock.getMode() == SimClock::Mode::Unlimited)
+        status += " (unlimited)";
+    
+    display.setStatus(status);
+}
+
+void GameFrontend::start() {
+    threadCont = true;
+    
+    auto seed = game.getMoveSeed();
+    
+    if (display.isHeadless()) {
+        SeedRandom(seed);
+        run();
+        return;
+    }
+    
+    display.setKeyHandler([this](SDL_Keycode key) {
+        switch (key) {
+            case SDLK_f:
+                clock.toggleFastForward();
+                break;
+            case SDLK_LEFTBRACKET:
+                clock.scaleRate(0.5);
+                break;
+            case SDLK_RIGHTBRACKET:
+                clock.scaleRate(2);
+                break;
+        }
+        
+        updateStatus();
+    });
+    
+    display.setFrameHandler([this] {
+        clock.frame();
+    });
+    
+    thread = std::thread([this, seed] {
+        SeedRandom(seed);
+        run();
+        display.stopRefreshing();
+    });
+    
+    display.startRefreshing();
+    
+    threadCont = false;
+    clock.stop();
+}
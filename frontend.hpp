@@ -0,0 +1,48 @@
+#ifndef FRONTEND_HPP
+#define FRONTEND_HPP
+
+
+#include <memory>
+#include <thread>
+#include "game.hpp"
+#include "ui.hpp"
+#include "capture.hpp"
+#include "clock.hpp"
+
+
+/*
+ * GameFrontend.
+ *
+ * Plays a game the way the command line does: paced by the config's clock,
+ * shown in a window unless headless, and recorded if the config asks for a
+ * capture. The game itself knows nothing of this; the front-end draws its
+ * screen and registers the sprites of its unit kinds in id order.
+ */
+
+class GameFrontend {
+private:
+    Game &game;
+    const Config &config;
+    
+    UIDisplay display;
+    SimClock  clock;
+    
+    std::thread thread;
+    volatile bool threadCont;
+    
+    std::unique_ptr<FrameCapture> capture;
+    
+    void run();
+    
+    void updateStatus();
+    
+public:
+    GameFrontend(Game &game);
+    ~GameFrontend();
+    
+    // Returns once the game has ended, reached maxMoves or the window was closed.
+    void start();
+};
+
+
+#endif
@@ -1,160 +1,675 @@
 #include "game.hpp"
 #include <fstream>
 #include <cstring>
-#include <functional>
-#include <array>
 #include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include "util.hpp"
+#include "pool.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 
-#include <iostream>
 
+/*
+ * Loading.
+ *
+ * Executables are assembled on a shared pool before the leagues are built,
+ * in config order so that sprite ids stay the same. Sprites are left to
+ * front-ends, see getSprites().
+ */
 
-Game::Game(const Config &config)
-: config(config), display(
-    0, 0, 0,
-    config.getColumnNumber() * config.getSpriteWidth(),
-    config.getRowNumber()    * config.getSpriteHeight(),
-    config.getColumnNumber(), config.getRowNumber(),
-    false, "The Game of Death"
-) {
-    board.resize(config.getColumnNumber() * config.getRowNumber(), nullptr);
+static ThreadPool &loadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+namespace {
+
+struct UnitKindLoad {
+    const LeagueInfo   *league;
+    const UnitKindInfo *kind;
+    
+    Executable exec;
+    
+    double assembly = 0;
+    std::exception_ptr error;
+    
+    UnitKindLoad(const LeagueInfo *league, const UnitKindInfo *kind) : league(league), kind(kind) {}
+};
+
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Game::Placement parsePlacement(const Config &config) {
+    auto placement = config.getPlacement();
+    
+    if (placement == "scan")
+        return Game::Placement::Scan;
+    
+    if (placement == "spread")
+        return Game::Placement::Spread;
+    
+    return Game::Placement::Random;
+}
+
+BoardLayout::BoardLayout(int columns, int rows, int tile) : shift(getShift(tile)) {
+    std::size_t side = std::size_t(1) << shift;
     
-    if (config.getUnitsPerLeague() * config.getLeagueInfo().size() > board.size())
+    mask        = static_cast<unsigned>(side - 1);
+    tilesPerRow = (columns + side - 1) >> shift;
+    cells       = tilesPerRow * ((rows + side - 1) >> shift) * side * side;
+}
+
+static Game::UnitOrder parseUnitOrder(const Config &config) {
+    auto order = config.getUnitOrder();
+    
+    if (order == "morton")
+        return Game::UnitOrder::Morton;
+    
+    if (order == "hilbert")
+        return Game::UnitOrder::Hilbert;
+    
+    return Game::UnitOrder::Insertion;
+}
+
+Game::Game(const Config &config, ExecutableCache *cache)
+: config(config), quantum(config.getQuantum()), batch(config.getBatch()), turnLeft(batch),
+columns(config.getColumnNumber()), rows(config.getRowNumber()), layout(columns, rows, config.getBoardTile()),
+paths(getBoardPaths(columns, rows, config.getBoardTile())),
+placement(parsePlacement(config)),
+stalemateWindow(config.getStalemateWindow()),
+unitOrder(parseUnitOrder(config)), unitOrderInterval(config.getUnitOrderInterval()) {
+    // Unseeded games go back to system randomness, whatever this thread played before.
+    SeedRandom(config.getSeed());
+    
+    board.resize(layout.size(), nullptr);
+    screen.resize(static_cast<std::size_t>(columns) * rows, 0);
+    sprites.push_back({0, nullptr, nullptr});
+    
+    // The first row and column are not part of the board, see isValidPosition().
+    if (config.getUnitsPerLeague() * config.getLeagueInfo().size() > static_cast<std::size_t>((config.getColumnNumber() - 1) * (config.getRowNumber() - 1)))
         throw std::invalid_argument("Too many units requested.");
     
-    for (auto &kv : config.getLeagueInfo())
-        leagues[kv.first] = League(*this, kv.second);
+    auto loadStart = std::chrono::steady_clock::now();
+    
+    std::vector<UnitKindLoad> loads;
+    
+    for (auto &league : config.getLeagueInfo())
+        for (auto &kind : league.second.unitKinds)
+            loads.emplace_back(&league.second, &kind.second);
+    
+    auto load = [&loads, &config, cache](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto &l = loads[i];
+            
+            try {
+                auto start = std::chrono::steady_clock::now();
+                auto path  = l.league->directory + '/' + l.kind->exec;
+                
+                auto source = config.findProgram(path);
+                
+                if (cache)
+                    l.exec = cache->get(path, source);
+                else if (source)
+                    l.exec = Executable::fromSource(*source, path);
+                else
+                    l.exec = Executable(path);
+                
+                l.assembly = secondsSince(start);
+            } catch (...) {
+                l.error = std::current_exception();
+            }
+        }
+    };
+    
+    if (loads.size() > 1) {
+        loadPool().parallelFor(loads.size(), load);
+        loadTimes.threads = static_cast<unsigned>(loadPool().size());
+    } else
+        load(0, loads.size());
+    
+    for (auto &l : loads) {
+        if (l.error)
+            std::rethrow_exception(l.error);
+        
+        loadTimes.assembly += l.assembly;
+    }
+    
+    loadTimes.unitKinds = loads.size();
+    loadTimes.loading   = secondsSince(loadStart);
+    
+    auto placementStart = std::chrono::steady_clock::now();
+    
+    unsigned id = 0;
+    auto next = loads.begin();
+    
+    leagues.reserve(config.getLeagueInfo().size());
+    
+    for (auto &kv : config.getLeagueInfo()) {
+        LOG(Info, Sched, "league {} is {}", id, kv.first);
+        TraceSeriesName(id, kv.first);
+        
+        std::unordered_map<std::string, UnitKind> kinds;
+        kinds.reserve(kv.second.unitKinds.size());
+        
+        for (auto &kind : kv.second.unitKinds) {
+            kinds[kind.first] = {
+                .sprite = static_cast<SpriteID>(sprites.size()),
+                .exec   = std::move(next->exec)
+            };
+            
+            sprites.push_back({id, &kv.second, &kind.second});
+            
+            next++;
+        }
+        
+        leagues.push_back(League(*this, kv.first, kv.second, id, std::move(kinds)));
+        active.push_back(id++);
+    }
+    
+    loadTimes.placement = secondsSince(placementStart);
+    
+    std::vector<std::uint32_t>().swap(freeCells);
+    freeCellsMove = -1;
+    
+    if (!active.empty())
+        turn = GetRandom(static_cast<std::uint32_t>(active.size()));
+    
+    if ((timeline.interval = config.getTimelineInterval())) {
+        timelineLeft = timeline.interval;
+        sampleTimeline();
+    }
 }
 
-Game::~Game() {
-    thread.join();
+void Game::sampleTimeline() {
+    timeline.moves.push_back(move);
+    
+    for (auto &league : leagues) {
+        timeline.biomass.push_back(league.getTotalBiomass());
+        timeline.population.push_back(league.getPopulation());
+    }
 }
 
-void Game::placeUnit(Unit &unit) {
+template <class Geometry>
+void Game::placeUnit(Unit &unit, const Geometry &geometry) {
     auto &pos = unit.getPosition();
-    board[pos.getY() * config.getColumnNumber() + pos.getX()] = &unit;
-    display.blitSprite(pos.getX(), pos.getY(), unit.getSpriteID());
+    board[geometry(pos.getX(), pos.getY())] = &unit;
+    screen[geometry.screen(pos.getX(), pos.getY())] = unit.getSpriteID();
+    rehashCell(pos.getX(), pos.getY(), geometry);
 }
 
-void Game::removeUnit(const Unit &unit) {
+template <class Geometry>
+void Game::removeUnit(const Unit &unit, const Geometry &geometry) {
     auto pos = unit.getPosition();
-    board[pos.getY() * config.getColumnNumber() + pos.getX()] = nullptr;
-    display.blitSprite(pos.getX(), pos.getY(), 0);
+    board[geometry(pos.getX(), pos.getY())] = nullptr;
+    screen[geometry.screen(pos.getX(), pos.getY())] = 0;
+    rehashCell(pos.getX(), pos.getY(), geometry);
+}
+
+void Game::placeUnit(Unit &unit) {
+    placeUnit(unit, getGeometry<AnyGeometry>());
+}
+
+void Game::removeUnit(const Unit &unit) {
+    removeUnit(unit, getGeometry<AnyGeometry>());
+}
+
+League *Game::findLeague(const std::string &name) {
+    for (auto &league : leagues)
+        if (league.getName() == name)
+            return &league;
+    
+    return nullptr;
 }
 
 bool Game::isValidPosition(int x, int y) const {
     return
-    x > 0 && x < config.getColumnNumber() &&
-    y > 0 && y < config.getRowNumber();
+    x > 0 && x < columns &&
+    y > 0 && y < rows;
 }
 
-bool Game::isFreePosition(int x, int y) const {
-    return isValidPosition(x, y) && !board[y * config.getColumnNumber() + x];
+template <class Geometry>
+bool Game::isFreePosition(int x, int y, const Geometry &geometry) const {
+    return geometry.contains(x, y) && !board[geometry(x, y)];
 }
 
-void Game::getRandomLocation(int &x, int &y) {
-    do {
-        x = GetRandom(config.getColumnNumber());
-        y = GetRandom(config.getRowNumber());
-    } while (!isFreePosition(x, y));
+bool Game::isFreePosition(int x, int y) const {
+    return isFreePosition(x, y, getGeometry<AnyGeometry>());
 }
 
-void Game::start() {
-    threadCont = true;
+void Game::getRandomLocation(int &x, int &y) {
+    if (freeCellsMove != move) {
+        freeCells.clear();
+        
+        for (int y = 1; y < rows; y++)
+            for (int x = 1; x < columns; x++)
+                if (!board[layout(x, y)])
+                    freeCells.push_back(y * columns + x);
+        
+        freeCellsTaken = 0;
+        freeCellsMove  = move;
+    }
     
-    thread = std::thread([this] {
-        int delay = config.getMoveDelay();
+    while (freeCellsTaken < freeCells.size()) {
+        auto i = freeCellsTaken + GetRandom(static_cast<std::uint32_t>(freeCells.size() - freeCellsTaken));
+        std::swap(freeCells[freeCellsTaken], freeCells[i]);
         
-        auto ileague = std::next(leagues.begin(), GetRandom((std::uint32_t)leagues.size()));
+        auto cell = freeCells[freeCellsTaken++];
         
-        int move = 0;
-        int maxMoves = config.getMaxMoves();
+        x = cell % columns;
+        y = cell / columns;
         
-        while (threadCont) {
-            auto &league = ileague->second;
-            
-            std::cout << ileague->first << ": " << league.getTotalBiomass() << '/' << league.units.size() << '\n';
+        // Units may have been placed on it in some other way since.
+        if (!board[layout(x, y)])
+            return;
+    }
+    
+    throw std::invalid_argument("No free cell left.");
+}
+
+void Game::getStartLocation(int &x, int &y) {
+    if (placement == Placement::Random) {
+        getRandomLocation(x, y);
+        return;
+    }
+    
+    std::size_t width = config.getColumnNumber() - 1;
+    std::size_t cells = width * (config.getRowNumber() - 1);
+    std::size_t total = config.getUnitsPerLeague() * config.getLeagueInfo().size();
+    
+    auto i = placed++;
+    
+    if (placement == Placement::Spread)
+        i = i * cells / total;
+    
+    x = 1 + static_cast<int>(i % width);
+    y = 1 + static_cast<int>(i / width);
+}
+
+std::uint64_t Game::hashBoard() const {
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    
+    auto mix = [&hash](std::uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 0x100000001B3ull;
+        }
+    };
+    
+    // Row by row whatever the layout, so that the hash does not depend on it.
+    for (int y = 0; y < config.getRowNumber(); y++)
+        for (int x = 0; x < config.getColumnNumber(); x++) {
+            auto unit = board[layout(x, y)];
             
-            if (auto unit = league.getNextUnit()) {
-                unit->execInsn(*this, league);
+            mix(unit ? unit->getSpriteID() : 0);
+            mix(unit ? unit->getWeight()   : 0);
+        }
+    
+    return hash;
+}
+
+bool Game::step(int moves) {
+    return paths.step(*this, moves);
+}
+
+template <class Geometry>
+bool Game::stepOn(int moves) {
+    if (active.empty() || ending != Ending::None)
+        return false;
+    
+    if (stalemateWindow && !stalemate)
+        startStalemate();
+    
+    const auto geometry = getGeometry<Geometry>();
+    
+    while (moves > 0) {
+        auto &league = leagues[active[turn]];
+        
+        LOG(Trace, Sched, "league {}: {}/{}", league.getID(), league.getTotalBiomass(), league.units.size());
+        
+        if (!slotLeft) {
+            if (!(slotUnit = league.getNextUnit())) {
+                LOG(Debug, Sched, "league {} eliminated after {} moves", league.getID(), move);
                 
-                if (++move == maxMoves)
-                    break;
+                endTurn();
                 
-                std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+                active.erase(active.begin() + turn);
+                if (active.size() < 2) {
+                    ending = Ending::Elimination;
+                    
+                    if (!active.empty())
+                        winner = leagues[active.front()].getName();
+                    
+                    return false;
+                }
                 
-                if (++ileague == leagues.end())
-                    ileague = leagues.begin();
-            } else {
-                ileague = leagues.erase(ileague);
-                if (leagues.size() < 2)
-                    break;
+                if (turn == active.size())
+                    turn = 0;
                 
-                if (ileague == leagues.end())
-                    ileague = leagues.begin();
+                continue;
             }
+            
+            slotLeft = quantum;
         }
         
-        display.stopRefreshing();
-    });
-    
-    display.startRefreshing();
+        auto unit = slotUnit;
+        
+        if (!turnStart && TraceActive.load(std::memory_order_relaxed))
+            turnStart = TraceNow();
+        
+        // The unit keeps the slot for 'quantum' moves in a row, or until it dies or the moves asked for are done.
+        do {
+            unit->execInsn(*this, league, geometry);
+            
+            move++;
+            moves--;
+            MetricsAdd(Metric::Moves);
+            
+            if (timeline.interval && !--timelineLeft) {
+                timelineLeft = timeline.interval;
+                sampleTimeline();
+            }
+            
+            if (stalemate && checkStalemate())
+                return false;
+        } while (--slotLeft && moves && !unit->isDead());
+        
+        // Left for the next call.
+        if (slotLeft && !unit->isDead())
+            break;
+        
+        // The turn ends after 'batch' slots.
+        slotLeft = 0;
+        
+        if (unitOrder != UnitOrder::Insertion)
+            league.endMove(*this);
+        
+        if (!--turnLeft) {
+            endTurn();
+            
+            if (++turn == active.size())
+                turn = 0;
+        }
+    }
     
-    threadCont = false;
+    return true;
 }
 
-static Sprite spriteFromInfo(const std::string &directory, const SpriteInfo *info) {
-    switch (info->getType()) {
-        case SpriteInfo::Type::SquareRGB: {
-            auto rgb = static_cast<const SpriteInfoSquareRGB *>(info);
-            return Sprite(rgb->red, rgb->green, rgb->blue);
-        }
-        case SpriteInfo::Type::ImagePath:
-            auto path = static_cast<const SpriteInfoImagePath *>(info);
-            return Sprite((directory + '/' + *path).c_str());
+void Game::endTurn() {
+    turnLeft = batch;
+    
+    if (turnStart) {
+        TraceComplete("turn", turnStart, TraceNow());
+        turnStart = 0;
     }
 }
 
-League::League(Game &game, const LeagueInfo &info) {
-    unitKinds.reserve(info.unitKinds.size());
-    for (auto &kv : info.unitKinds) {
-        unitKinds[kv.first] = {
-            .sprite = game.registerSprite(spriteFromInfo(info.directory, kv.second.sprite.get())),
-            .exec   = Executable(info.directory + '/' + kv.second.exec)
-        };
+/*
+ * Stalemates.
+ *
+ * A cycle is looked for in the board hash with Brent's algorithm and, as
+ * directions and program counters are not hashed, must come round
+ * 'stalemateRepeats' more times before the game is called a draw. At the
+ * end of every window the biomass share of each league is recorded; once
+ * no share has moved by more than 'stalemateTolerance' over the last
+ * 'stalemateWindows' windows, the game is won by a league holding at least
+ * 'stalemateShare' of the biomass, or else drawn.
+ */
+
+static std::uint64_t cellKey(std::size_t cell, SpriteID sprite, Unit::Weight weight) {
+    std::uint64_t z =
+    (cell + 1) * 0x9E3779B97F4A7C15ull ^
+    sprite     * 0xC2B2AE3D27D4EB4Full ^
+    static_cast<std::uint64_t>(weight) * 0x165667B19E3779F9ull;
+    
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    
+    return z ^ (z >> 31);
+}
+
+template <class Geometry>
+void Game::rehashCell(int x, int y, const Geometry &geometry) {
+    if (!stalemate)
+        return;
+    
+    auto i = geometry(x, y);
+    
+    auto unit = board[i];
+    auto key  = unit ? cellKey(i, unit->getSpriteID(), unit->getWeight()) : 0;
+    
+    stalemate->hash ^= stalemate->cells[i] ^ key;
+    stalemate->cells[i] = key;
+}
+
+template <class Geometry>
+void Game::rehashUnit(const Unit &unit, const Geometry &geometry) {
+    rehashCell(unit.getPosition().getX(), unit.getPosition().getY(), geometry);
+}
+
+void Game::startStalemate() {
+    stalemate.reset(new Stalemate);
+    
+    auto &s = *stalemate;
+    s.cells.resize(board.size(), 0);
+    
+    for (std::size_t i = 0; i < board.size(); i++)
+        if (auto unit = board[i])
+            s.hash ^= s.cells[i] = cellKey(i, unit->getSpriteID(), unit->getWeight());
+    
+    s.saved = s.hash;
+}
+
+bool Game::checkStalemate() {
+    auto &s = *stalemate;
+    
+    if (s.period && move == s.confirmAt) {
+        if (s.hash != s.expected)
+            s.period = 0;
+        else if (++s.repeats >= config.getStalemateRepeats()) {
+            LOG(Debug, Sched, "cycle of {} moves after {} moves", s.period, move);
+            
+            ending = Ending::Cycle;
+            return true;
+        } else
+            s.confirmAt += s.period;
     }
     
-    auto &cfg = game.getConfig();
+    s.length++;
+    
+    if (!s.period && s.hash == s.saved) {
+        s.period    = s.length;
+        s.repeats   = 0;
+        s.confirmAt = move + s.period;
+        s.expected  = s.hash;
+    }
+    
+    if (s.length >= s.power) {
+        s.saved  = s.hash;
+        s.power  = std::min(s.power * 2, stalemateWindow);
+        s.length = 0;
+    }
+    
+    if (move % stalemateWindow)
+        return false;
+    
+    std::vector<double> shares(leagues.size(), 0);
+    double total = 0;
+    
+    for (auto id : active)
+        total += shares[id] = leagues[id].getTotalBiomass();
+    
+    if (total > 0)
+        for (auto &share : shares)
+            share /= total;
+    
+    s.shares.push_back(shares);
+    
+    if (s.shares.size() > static_cast<std::size_t>(config.getStalemateWindows()) + 1)
+        s.shares.pop_front();
+    else if (s.shares.size() <= static_cast<std::size_t>(config.getStalemateWindows()))
+        return false;
+    
+    for (std::size_t i = 0; i < shares.size(); i++) {
+        auto range = std::minmax_element(s.shares.begin(), s.shares.end(), [i](const std::vector<double> &a, const std::vector<double> &b) {
+            return a[i] < b[i];
+        });
+        
+        if ((*range.second)[i] - (*range.first)[i] > config.getStalemateTolerance())
+            return false;
+    }
+    
+    auto best = std::max_element(shares.begin(), shares.end());
+    
+    if (*best >= config.getStalemateShare())
+        winner = leagues[best - shares.begin()].getName();
+    
+    LOG(Debug, Sched, "steady state after {} moves", move);
+    
+    ending = Ending::SteadyState;
+    return true;
+}
+
+std::uint64_t Game::getMoveSeed() const {
+    return config.getSeed() ? config.getSeed() ^ 0x6A09E667F3BCC909ull : 0;
+}
 
-    auto &skind = unitKinds[info.startKind];
+League::League(Game &game, const std::string &name, const LeagueInfo &info, unsigned id, std::unordered_map<std::string, UnitKind> &&kinds)
+: id(id), name(name), unitKinds(std::move(kinds)), startKind(info.startKind) {
+    auto &cfg = game.getConfig();
     
     units.reserve(cfg.getColumnNumber() * cfg.getRowNumber());
     
     for (int i = 0; i < cfg.getUnitsPerLeague(); i++) {
         int x, y;
-        game.getRandomLocation(x, y);
+        game.getStartLocation(x, y);
+        
+        spawnUnit(game, x, y);
+    }
+}
+
+Unit &League::spawnUnit(Game &game, int x, int y) {
+    auto &skind = unitKinds[startKind];
+    
+    units.push_back(Unit(skind.sprite, &skind.exec, x, y));
+    game.placeUnit(units.back());
+    
+    // Not through Game::reweigh(), as the initial units are placed before the league is in the game.
+    biomass += units.back().getWeight();
+    population++;
+    
+    return units.back();
+}
+
+/*
+ * Space-filling curves: units close along either of them are close on the
+ * board, so sorting by them makes consecutive moves touch nearby cells.
+ */
+
+static std::uint64_t MortonIndex(std::uint32_t x, std::uint32_t y) {
+    auto spread = [](std::uint64_t v) {
+        v = (v | v << 16) & 0x0000FFFF0000FFFFull;
+        v = (v | v << 8)  & 0x00FF00FF00FF00FFull;
+        v = (v | v << 4)  & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | v << 2)  & 0x3333333333333333ull;
+        v = (v | v << 1)  & 0x5555555555555555ull;
+        return v;
+    };
+    
+    return spread(x) | spread(y) << 1;
+}
+
+// 'n' is a power of two no less than either side of the board.
+static std::uint64_t HilbertIndex(std::uint32_t n, std::uint32_t x, std::uint32_t y) {
+    std::uint64_t d = 0;
+    
+    for (std::uint32_t s = n / 2; s > 0; s /= 2) {
+        std::uint32_t rx = (x & s) ? 1 : 0;
+        std::uint32_t ry = (y & s) ? 1 : 0;
         
-        units.push_back(Unit(skind.sprite, &skind.exec, x, y));
+        d += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
         
-        game.placeUnit(units.back());
+        if (!ry) {
+            if (rx) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            
+            std::swap(x, y);
+        }
     }
+    
+    return d;
 }
 
-std::uint64_t League::getTotalBiomass() const {
-    std::uint64_t total = 0;
+void League::sortUnits(Game &game) {
+    TraceSpan span("sortUnits");
+    
+    // The dead are left behind, as getNextUnit() would drop them anyway.
+    units.erase(std::remove_if(units.begin(), units.end(), [](const Unit &unit) {
+        return unit.isDead();
+    }), units.end());
+    
+    std::uint32_t n = 1;
+    while (n < static_cast<std::uint32_t>(std::max(game.columns, game.rows)))
+        n *= 2;
+    
+    order.clear();
+    
+    for (std::size_t i = 0; i < units.size(); i++) {
+        auto &pos = units[i].getPosition();
+        
+        auto index = game.getUnitOrder() == Game::UnitOrder::Hilbert ?
+        HilbertIndex(n, pos.getX(), pos.getY()) : MortonIndex(pos.getX(), pos.getY());
+        
+        order.push_back({index, static_cast<std::uint32_t>(i)});
+    }
+    
+    std::sort(order.begin(), order.end());
+    
+    // Moved back rather than swapped in, since 'units' must keep its capacity.
+    staging.clear();
+    for (auto &o : order)
+        staging.push_back(std::move(units[o.second]));
+    
+    std::move(staging.begin(), staging.end(), units.begin());
     
     for (auto &unit : units)
-        if (!unit.isDead())
-            total += unit.getWeight();
+        game.board[game.layout(unit.getPosition().getX(), unit.getPosition().getY())] = &unit;
+    
+    nextUnitIndex = 0;
+}
+
+void Game::reweigh(const Unit &unit, std::int64_t before) {
+    auto &league = leagues[sprites[unit.getSpriteID()].league];
+    
+    // Cells can still point past the end of the units once getNextUnit() has dropped the dead; what is left there is not counted.
+    if (&unit >= league.units.data() + league.units.size())
+        return;
+    
+    if (before > 0) {
+        league.biomass -= before;
+        league.population--;
+    }
     
-    return total;
+    if (!unit.isDead()) {
+        league.biomass += unit.getWeight();
+        league.population++;
+    }
 }
 
-void Unit::Position::move(const Game &game, Direction dir) {
+template <class Geometry>
+void Unit::Position::move(const Game &game, const Geometry &geometry, Direction dir) {
     auto pos = *this;
     pos.move(dir);
     
-    if (game.isFreePosition(pos.getX(), pos.getY()))
+    if (game.isFreePosition(pos.getX(), pos.getY(), geometry))
         *this = pos;
 }
 
@@ -180,41 +695,59 @@ std::string Unit::Position::stringValue() {
 }
 
 void Unit::execInsn(Game &game, League &league) {
-    auto eat = [this] {
+    game.paths.execInsn(game, league, *this);
+}
+
+template <class Geometry>
+void Unit::execInsn(Game &game, League &league, const Geometry &geometry) {
+    auto eat = [this, &game, &geometry] {
         weight++;
+        game.rehashUnit(*this, geometry);
+        game.reweigh(*this, weight - 1);
     };
     
-    auto go = [this, &game] {
-        if (!loseWeight(game, 1))
+    auto go = [this, &game, &geometry] {
+        if (!loseWeight(game, geometry, 1))
             return;
         
-        game.removeUnit(*this);
-        position.move(game, direction);
-        game.placeUnit(*this);
+        game.removeUnit(*this, geometry);
+        position.move(game, geometry, direction);
+        game.placeUnit(*this, geometry);
     };
     
-    auto clon = [this, &game, &league] {
-        if (!loseWeight(game, 10))
+    auto clon = [this, &game, &league, &geometry] {
+        if (!loseWeight(game, geometry, 10))
             return;
         
         auto pos = position;
-        pos.move(game, direction);
+        pos.move(game, geometry, direction);
         
-        if (!game.isValidPosition(pos.getX(), pos.getY()))
+        if (!geometry.contains(pos.getX(), pos.getY()))
             return;
         
-        if (auto unit = game.board[pos.getY() * game.getConfig().getColumnNumber() + pos.getX()])
+        if (auto unit = game.board[geometry(pos.getX(), pos.getY())]) {
             unit->weight += 2;
-        else {
+            game.rehashCell(pos.getX(), pos.getY(), geometry);
+            game.reweigh(*unit, unit->weight - 2);
+        } else {
             league.units.push_back(Unit(sprite, exec, pos.getX(), pos.getY(), true));
-            game.placeUnit(league.units.back());
+            game.placeUnit(league.units.back(), geometry);
+            
+            league.biomass += league.units.back().getWeight();
+            league.population++;
         }
     };
     
-    auto str = [this, &game] {
-        if (loseWeight(game, 1))
-            if (auto enemy = findEnemy(game))
-                enemy->damage(game, weight);
+    auto str = [this, &game, &geometry] {
+        if (loseWeight(game, geometry, 1)) {
+            if (auto enemy = findEnemy(game, geometry)) {
+                enemy->damage(game, geometry, weight);
+                
+                LOG(Debug, Combat, "{},{} strikes {},{} down to {}",
+                    position.getX(), position.getY(),
+                    enemy->position.getX(), enemy->position.getY(), enemy->weight);
+            }
+        }
     };
     
     auto left = [this] {
@@ -233,157 +766,247 @@ void Unit::execInsn(Game &game, League &league) {
         direction = getRandomDirection();
     };
     
+    ProfileMove profile(*exec);
+    
     if (insnRepCnt) {
+        profile.repeat(pc);
+        
         switch (insnRep) {
             case InsnRep::Eat:
-                std::cout << "rep eat\n";
+                LOG(Trace, Insn, "{},{} rep eat", position.getX(), position.getY());
                 eat();
                 break;
             case InsnRep::Go:
-                std::cout << "rep go\n";
+                LOG(Trace, Insn, "{},{} rep go", position.getX(), position.getY());
                 go();
                 break;
             case InsnRep::Str:
-                std::cout << "rep str\n";
+                LOG(Trace, Insn, "{},{} rep str", position.getX(), position.getY());
                 str();
                 break;
         }
         
+        profile.repeated();
+        MetricsAdd(Metric::Instructions);
+        
         insnRepCnt--;
     } else {
-        struct Handler {
-            std::function<void()> fn;
-            std::size_t size;
-            bool pseudo;
-        };
-        
-        std::array<Handler, Executable::InsnMax + 1> handlers = {
-#define REP_HANDLER(c, f) \
-            Handler {\
-                .fn = [this, f] {\
-                    insnRep = InsnRep::c;\
-                    insnRepCnt = (*exec)[pc + 1] ? (*exec)[pc + 1] : GetRandom(5);\
-                    \
-                    if (!insnRepCnt)\
-                        return;\
-                    \
-                    f();\
-                    \
-                    insnRepCnt--;\
-                }, .size = 2, .pseudo = false\
-            }
-            
-            REP_HANDLER(Eat, eat),
-            REP_HANDLER(Go,  go),
-            
-            Handler {.fn = clon, .size = 1, .pseudo = false},
+        // The rep instructions: the operand, or a random count if it is 0, times 'f'.
+        auto repeat = [this](InsnRep rep, const auto &f) {
+            insnRep = rep;
+            insnRepCnt = (*exec)[pc + 1] ? (*exec)[pc + 1] : GetRandom(5);
             
-            REP_HANDLER(Str, str),
+            if (!insnRepCnt)
+                return;
             
-            Handler {.fn = left,  .size = 1, .pseudo = true},
-            Handler {.fn = right, .size = 1, .pseudo = true},
-            Handler {.fn = back,  .size = 1, .pseudo = true},
-            Handler {.fn = turn,  .size = 1, .pseudo = true},
+            f();
             
-            Handler {
-                .fn = [this] {
-                    if (weight > (*exec)[pc + 1])
-                        pc = (*exec)[pc + 2];
-                    else
-                        pc += 3;
-                },
-                .size = 0, .pseudo = true
-            },
-            
-            Handler {
-                .fn = [this] {
-                    if (weight < (*exec)[pc + 1])
-                        pc = (*exec)[pc + 2];
-                    else
-                        pc += 3;
-                },
-                .size = 0, .pseudo = true
-            },
-            
-            Handler {
-                .fn = [this] {
+            insnRepCnt--;
+        };
+        
+        // A switch rather than a table of handlers, so that they inline with the board geometry.
+        auto dispatch = [&](Executable::Word opcode, Executable::Word &size) {
+            switch (opcode) {
+                case Executable::InsnEat:
+                    repeat(InsnRep::Eat, eat);
+                    size = 2;
+                    return false;
+                case Executable::InsnGo:
+                    repeat(InsnRep::Go, go);
+                    size = 2;
+                    return false;
+                case Executable::InsnClon:
+                    clon();
+                    size = 1;
+                    return false;
+                case Executable::InsnStr:
+                    repeat(InsnRep::Str, str);
+                    size = 2;
+                    return false;
+                case Executable::InsnLeft:
+                    left();
+                    size = 1;
+                    return true;
+                case Executable::InsnRight:
+                    right();
+                    size = 1;
+                    return true;
+                case Executable::InsnBack:
+                    back();
+                    size = 1;
+                    return true;
+                case Executable::InsnTurn:
+                    turn();
+                    size = 1;
+                    return true;
+                case Executable::InsnJG:
+                    pc = weight > (*exec)[pc + 1] ? (*exec)[pc + 2] : pc + 3;
+                    break;
+                case Executable::InsnJL:
+                    pc = weight < (*exec)[pc + 1] ? (*exec)[pc + 2] : pc + 3;
+                    break;
+                case Executable::InsnJ:
                     pc = (*exec)[pc + 1];
-                },
-                .size = 0, .pseudo = true
-            },
-            
-            Handler {
-                .fn = [this, &game] {
-                    if (findEnemy(game))
-                        pc = (*exec)[pc + 1];
-                    else
-                        pc += 2;
-                },
-                .size = 0, .pseudo = true
+                    break;
+                case Executable::InsnJE:
+                    pc = findEnemy(game, geometry) ? (*exec)[pc + 1] : pc + 2;
+                    break;
             }
             
-#undef REP_HANDLER
+            size = 0;
+            return true;
         };
         
-        int mad = 0;
+        int mad = 0, dispatches = 0, pseudo = 0;
         while (true) {
             auto opcode = (*exec)[pc];
-            assert(opcode < handlers.size());
+            assert(opcode <= Executable::InsnMax);
+            
+            LOG(Trace, Insn, "{},{} pc {}: {}", position.getX(), position.getY(), pc, DisasmOpcode(opcode));
+            
+            Executable::Word size;
+            
+            profile.dispatch(pc, opcode);
+            bool isPseudo = dispatch(opcode, size);
+            profile.dispatched(isPseudo);
             
-            std::cout << DisasmOpcode(opcode) << '\n';
+            pc += size;
             
-            auto &h = handlers[opcode];
-            h.fn();
-            pc += h.size;
+            dispatches++;
+            pseudo += isPseudo;
             
             if (pc >= exec->size())
                 pc = 0;
             
-            if (!h.pseudo || weight <= 0)
+            if (!isPseudo || weight <= 0)
                 break;
             
             if (++mad >= 31) {
-                loseWeight(game, 5);
+                MetricsAdd(Metric::MadPenalties);
+                profile.penalty();
+                loseWeight(game, geometry, 5);
                 break;
             }
         }
+        
+        MetricsAdd(Metric::Instructions, dispatches);
+        MetricsAdd(Metric::PseudoDispatches, pseudo);
+        MetricsObserve(MetricHistogram::DispatchesPerMove, dispatches);
     }
 }
 
 Unit *Unit::findEnemy(Game &game) {
+    return game.paths.findEnemy(game, *this);
+}
+
+template <class Geometry>
+Unit *Unit::findEnemy(Game &game, const Geometry &geometry) const {
     auto pos = position;
     
-    pos.move(game, direction);
+    // Like Position::move(): stays put unless the next cell is free.
+    auto move = [&game, &geometry, &pos](Direction dir) {
+        auto next = pos;
+        next.move(dir);
+        
+        if (geometry.contains(next.getX(), next.getY()) && !game.board[geometry(next.getX(), next.getY())])
+            pos = next;
+    };
+    
+    auto at = [&game, &geometry, &pos] {
+        return game.board[geometry(pos.getX(), pos.getY())];
+    };
+    
+    move(direction);
     
-    if (auto enemy = game.board[pos.getY() * game.getConfig().getColumnNumber() + pos.getX()])
+    if (auto enemy = at())
         return enemy;
     
     auto dir = direction + 1;
     
-    pos.move(game, dir);
+    move(dir);
     
-    if (auto enemy = game.board[pos.getY() * game.getConfig().getColumnNumber() + pos.getX()])
+    if (auto enemy = at())
         return enemy;
     
     for (int i = 0; i < 3; i++) {
         dir++;
         
         for (int i = 0; i < 2; i++) {
-            if (auto enemy = game.board[pos.getY() * game.getConfig().getColumnNumber() + pos.getX()])
+            if (auto enemy = at())
                 return enemy;
             
-            pos.move(game, dir);
+            move(dir);
+        }
+    }
+    
+    return at();
+}
+
+/*
+ * BoardPaths.
+ */
+
+template <class Geometry>
+Game::BoardPaths Game::getBoardPaths() {
+    return {
+        [](Game &game, int moves) {
+            return game.stepOn<Geometry>(moves);
+        },
+        [](Game &game, League &league, Unit &unit) {
+            unit.execInsn(game, league, game.getGeometry<Geometry>());
+        },
+        [](Game &game, const Unit &unit) {
+            return unit.findEnemy(game, game.getGeometry<Geometry>());
+        }
+    };
+}
+
+template <int Side>
+Game::BoardPaths Game::getBoardPaths(int tile) {
+    switch (tile) {
+        case 0:  return getBoardPaths<BoardGeometry<Side, Side, 0>>();
+        case 8:  return getBoardPaths<BoardGeometry<Side, Side, 8>>();
+        case 16: return getBoardPaths<BoardGeometry<Side, Side, 16>>();
+    }
+    
+    return getBoardPaths<AnyGeometry>();
+}
+
+Game::BoardPaths Game::getBoardPaths(int columns, int rows, int tile) {
+    if (columns == rows) {
+        switch (columns) {
+            case 64:   return getBoardPaths<64>(tile);
+            case 128:  return getBoardPaths<128>(tile);
+            case 256:  return getBoardPaths<256>(tile);
+            case 512:  return getBoardPaths<512>(tile);
+            case 1024: return getBoardPaths<1024>(tile);
         }
     }
     
-    return game.board[pos.getY() * game.getConfig().getColumnNumber() + pos.getX()];
+    return getBoardPaths<AnyGeometry>();
+}
+
+void Unit::setWeight(Game &game, Weight weight) {
+    auto before = this->weight;
+    this->weight = weight;
+    game.reweigh(*this, before);
 }
 
-bool Unit::loseWeight(Game &game, Weight loss) {
-    if ((weight -= loss) > 0)
+template <class Geometry>
+bool Unit::loseWeight(Game &game, const Geometry &geometry, Weight loss) {
+    auto before = weight;
+    weight -= loss;
+    
+    game.reweigh(*this, before);
+    
+    if (weight > 0) {
+        game.rehashUnit(*this, geometry);
         return true;
+    }
+    
+    LOG(Debug, Combat, "{},{} dies", position.getX(), position.getY());
     
-    game.removeUnit(*this);
+    game.removeUnit(*this, geometry);
     
     return false;
 }
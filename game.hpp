@@ -7,13 +7,13 @@
 #include <vector>
 #include <unordered_map>
 #include <stdexcept>
-#include <thread>
 #include <cstdlib>
 #include <ostream>
+#include <deque>
 
 #include "executable.hpp"
-#include "ui.hpp"
 #include "config.hpp"
+#include "util.hpp"
 
 
 class  Game;
@@ -23,35 +23,320 @@ class  Unit;
 struct UnitKind;
 class  Executable;
 
+/*
+ * BoardLayout.
+ *
+ * Where a cell lives in the board's storage. The board is cut into square
+ * tiles of 2^shift cells a side; the tiles, and the cells inside each one,
+ * go row by row, so that neighbours usually share a cache line. A shift of
+ * zero is the plain row-major layout.
+ */
+
+class BoardLayout {
+private:
+    unsigned    shift = 0, mask = 0;
+    std::size_t tilesPerRow = 0, cells = 0;
+    
+public:
+    BoardLayout() {}
+    
+    // 'tile' is a power of two, or 0 for rows.
+    BoardLayout(int columns, int rows, int tile);
+    
+    static constexpr unsigned getShift(int tile) {
+        return tile > 1 ? 1 + getShift(tile / 2) : 0;
+    }
+    
+    // Where (x, y) lives in tiles of 2^shift cells a side, 'tilesPerRow' to a row of them.
+    static std::size_t index(int x, int y, unsigned shift, unsigned mask, std::size_t tilesPerRow) noexcept {
+        return
+        ((static_cast<std::size_t>(y >> shift) * tilesPerRow + (x >> shift)) << (2 * shift)) |
+        ((y & mask) << shift) | (x & mask);
+    }
+    
+    std::size_t operator()(int x, int y) const noexcept {
+        return index(x, y, shift, mask, tilesPerRow);
+    }
+    
+    // The number of cells stored, partial tiles included.
+    std::size_t size() const noexcept {return cells;}
+};
+
+/*
+ * BoardGeometry.
+ *
+ * The board size and layout as the move path sees them (see
+ * Game::BoardPaths). Square boards of the usual tournament sizes, by rows or
+ * in tiles of 8 or 16, get both as constants, so that a cell is found with
+ * shifts and masks alone; every other board uses BoardGeometry<0, 0, 0>,
+ * which reads them at run time. The index of a cell is the BoardLayout's
+ * either way.
+ */
+
+template <int Columns, int Rows, int Tile>
+class BoardGeometry {
+private:
+    static constexpr unsigned    shift       = BoardLayout::getShift(Tile);
+    static constexpr unsigned    mask        = (1u << shift) - 1;
+    static constexpr std::size_t tilesPerRow = (Columns + mask) >> shift;
+    
+public:
+    BoardGeometry(int, int, const BoardLayout &) {}
+    
+    bool contains(int x, int y) const noexcept {
+        return x > 0 && x < Columns && y > 0 && y < Rows;
+    }
+    
+    std::size_t operator()(int x, int y) const noexcept {
+        return BoardLayout::index(x, y, shift, mask, tilesPerRow);
+    }
+    
+    // In the screen, which is row by row.
+    std::size_t screen(int x, int y) const noexcept {
+        return static_cast<std::size_t>(y) * Columns + x;
+    }
+};
+
+template <>
+class BoardGeometry<0, 0, 0> {
+private:
+    int columns, rows;
+    const BoardLayout &layout;
+    
+public:
+    BoardGeometry(int columns, int rows, const BoardLayout &layout)
+    : columns(columns), rows(rows), layout(layout) {}
+    
+    bool contains(int x, int y) const noexcept {
+        return x > 0 && x < columns && y > 0 && y < rows;
+    }
+    
+    std::size_t operator()(int x, int y) const noexcept {return layout(x, y);}
+    
+    std::size_t screen(int x, int y) const noexcept {
+        return static_cast<std::size_t>(y) * columns + x;
+    }
+};
+
 /*
  * Game.
  */
 
 class Game {
     friend Unit;
+    friend League;
+    
+public:
+    enum class UnitOrder {
+        Insertion,
+        Morton,
+        Hilbert
+    };
+    
+    // What a sprite id stands for; the empty cell has no league or kind.
+    struct SpriteSource {
+        unsigned            league;
+        const LeagueInfo   *leagueInfo;
+        const UnitKindInfo *kind;
+    };
     
 private:
-    UIDisplay display;
     const Config &config;
     
-    typedef std::unordered_map<std::string, League> LeagueMap;
+    // Every league by id, and the ids of those still playing in turn order.
+    std::vector<League>   leagues;
+    std::vector<unsigned> active;
+    std::size_t           turn = 0;
     
-    LeagueMap leagues;
+    /*
+     * A league's turn is 'batch' slots, each giving one of its units
+     * 'quantum' moves in a row, or fewer if the unit dies.
+     */
     
-    std::thread thread;
-    volatile bool threadCont;
+    int   quantum, batch;
+    int   turnLeft, slotLeft = 0;
+    Unit *slotUnit = nullptr;
     
+    // When the current turn started on the trace clock, 0 unless it is being traced.
+    std::int64_t turnStart = 0;
+    
+    void endTurn();
+    
+    int move = 0;
+    
+    // Cached from the config, which is slow to read.
+    int columns, rows;
+    
+    BoardLayout layout;
     std::vector<Unit *> board;
     
+    // The sprite in every cell, row by row whatever the layout, for front-ends.
+    std::vector<SpriteID>     screen;
+    std::vector<SpriteSource> sprites;
+    
+    typedef BoardGeometry<0, 0, 0> AnyGeometry;
+    
+    template <class Geometry>
+    Geometry getGeometry() const {return Geometry(columns, rows, layout);}
+    
+    /*
+     * The move path built for one BoardGeometry. The one for this board is
+     * picked when the game is built; step(), Unit::execInsn() and
+     * Unit::findEnemy() go through it, and it on to the board helpers below
+     * that take a geometry.
+     */
+    struct BoardPaths {
+        bool  (*step)(Game &game, int moves);
+        void  (*execInsn)(Game &game, League &league, Unit &unit);
+        Unit *(*findEnemy)(Game &game, const Unit &unit);
+    };
+    
+    BoardPaths paths;
+    
+    static BoardPaths getBoardPaths(int columns, int rows, int tile);
+    
+    template <int Side>
+    static BoardPaths getBoardPaths(int tile);
+    
+    template <class Geometry>
+    static BoardPaths getBoardPaths();
+    
+    template <class Geometry>
+    bool stepOn(int moves);
+    
+    template <class Geometry>
+    void placeUnit(Unit &unit, const Geometry &geometry);
+    
+    template <class Geometry>
+    void removeUnit(const Unit &unit, const Geometry &geometry);
+    
+    template <class Geometry>
+    bool isFreePosition(int x, int y, const Geometry &geometry) const;
+    
+    /*
+     * getRandomLocation() deals cells from a partial Fisher-Yates shuffle of
+     * the free ones: [0, freeCellsTaken) have been dealt. The list is made
+     * again once moves have been played since it was made.
+     */
+    
+    std::vector<std::uint32_t> freeCells;
+    std::size_t freeCellsTaken = 0;
+    int         freeCellsMove  = -1;
+    
+public:
+    enum class Placement {
+        Random,
+        Scan,   // row by row from the top left, league after league
+        Spread  // evenly spaced over the board, league after league
+    };
+    
+private:
+    Placement   placement;
+    std::size_t placed = 0;
+    
+public:
+    enum class Ending {
+        None,         // still running, or stopped at maxMoves
+        Elimination,  // at most one league is left
+        Cycle,        // the board keeps coming back to the same state
+        SteadyState   // the biomass shares of the leagues have stopped changing
+    };
+    
+private:
+    Ending      ending = Ending::None;
+    std::string winner;
+    
+    /*
+     * Stalemate detection, set up by the first step() when the config has a
+     * stalemate window.
+     *
+     * 'hash' is a Zobrist hash of the sprite and the weight of every cell.
+     * The key of a cell is 'cells[i]' and is mixed from the cell's state
+     * rather than looked up, so that weights need no table; it is updated
+     * whenever a unit is placed, removed or changes weight.
+     */
+    
+    struct Stalemate {
+        std::vector<std::uint64_t> cells;
+        std::uint64_t hash = 0;
+        
+        // Brent's cycle finding, with the power capped at the window.
+        std::uint64_t saved = 0;
+        int power = 1, length = 0;
+        
+        // A cycle found is only believed once it has come round a few more times.
+        int period = 0, repeats = 0, confirmAt = 0;
+        std::uint64_t expected = 0;
+        
+        std::deque<std::vector<double>> shares;  // of the biomass by league id, one per window
+    };
+    
+    int stalemateWindow;
+    std::unique_ptr<Stalemate> stalemate;
+    
+    UnitOrder unitOrder;
+    int       unitOrderInterval;
+    
+    void startStalemate();
+    bool checkStalemate();
+    
+    template <class Geometry>
+    void rehashCell(int x, int y, const Geometry &geometry);
+    
+    template <class Geometry>
+    void rehashUnit(const Unit &unit, const Geometry &geometry);
+    
+    // Keeps the biomass and population of the unit's league up to date after its weight was 'before'.
+    void reweigh(const Unit &unit, std::int64_t before);
+    
 public:
-    Game(const Config &config);
-    ~Game();
+    // Seconds spent building the game; assembly is summed over threads.
+    struct LoadTimes {
+        double assembly = 0;
+        double loading = 0, placement = 0;
+        std::size_t unitKinds = 0;
+        unsigned threads = 1;
+    };
+    
+private:
+    LoadTimes loadTimes;
+    
+public:
+    /*
+     * The biomass and population of every league by id, taken when the game
+     * is built and then every 'interval' moves: sample i was taken at
+     * moves[i] and its values are [i * leagues, (i + 1) * leagues).
+     */
+    struct Timeline {
+        int interval = 0;
+        std::vector<int>           moves;
+        std::vector<std::uint64_t> biomass, population;
+    };
+    
+private:
+    Timeline timeline;
+    int      timelineLeft = 0;
+    
+    void sampleTimeline();
     
-    SpriteID registerSprite(const Sprite &sprite) {return display.registerSprite(sprite);}
+public:
+    // Executables come from 'cache' when given, see ExecutableCache.
+    Game(const Config &config, ExecutableCache *cache = nullptr);
     
     const Config &getConfig() const {return config;}
     
-    const LeagueMap &getLeagues() const {return leagues;}
+    // columnNumber x rowNumber sprite ids; the first row and column are always empty.
+    const std::vector<SpriteID>     &getScreen()  const noexcept {return screen;}
+    const std::vector<SpriteSource> &getSprites() const noexcept {return sprites;}
+    
+    // By id, eliminated ones included; names are only for reporting.
+    const std::vector<League> &getLeagues() const {return leagues;}
+    std::vector<League>       &getLeagues()       {return leagues;}
+    
+    const std::vector<unsigned> &getActiveLeagues() const {return active;}
+    
+    // Null if there is no league of that name.
+    League *findLeague(const std::string &name);
     
     void placeUnit(Unit &unit);
     void removeUnit(const Unit &unit);
@@ -59,9 +344,41 @@ public:
     bool isValidPosition(int x, int y) const;
     bool isFreePosition(int x, int y) const;
     
+    // Throws std::invalid_argument when no free cell is left.
     void getRandomLocation(int &x, int &y);
     
-    void start();
+    // Where the next unit of the initial set goes, as the config's placement says.
+    void getStartLocation(int &x, int &y);
+    
+    /*
+     * Runs the next 'moves' moves, fewer only if the game ends. Returns false
+     * once it has: fewer than two leagues are left or on a stalemate.
+     */
+    bool step(int moves = 1);
+    
+    int getMove() const noexcept {return move;}
+    
+    UnitOrder getUnitOrder()         const noexcept {return unitOrder;}
+    int       getUnitOrderInterval() const noexcept {return unitOrderInterval;}
+    
+    Ending getEnding() const noexcept {return ending;}
+    
+    // The league left or dominating a steady state, empty for a draw.
+    const std::string &getWinner() const noexcept {return winner;}
+    
+    // The length of the cycle that ended the game.
+    int getCyclePeriod() const noexcept {return stalemate ? stalemate->period : 0;}
+    
+    const LoadTimes &getLoadTimes() const noexcept {return loadTimes;}
+    
+    // Empty unless the config has a timeline interval.
+    const Timeline &getTimeline() const noexcept {return timeline;}
+    
+    // FNV-1a over the sprite and the weight of every cell, for checking that seeded games are reproduced.
+    std::uint64_t hashBoard() const;
+    
+    // Moves draw from their own stream after loading, the same with or without a window; 0 if unseeded.
+    std::uint64_t getMoveSeed() const;
 };
 
 /*
@@ -69,20 +386,54 @@ public:
  */
 
 class League {
+    friend Game;
+    friend Unit;
+    
 private:
+    unsigned    id = 0;
+    std::string name;
+    
     std::unordered_map<std::string, UnitKind> unitKinds;
+    std::string startKind;
+    
     std::size_t nextUnitIndex = 0;
     
     std::vector<Unit> staging;
     
+    std::size_t rounds = 0;
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> order;
+    
+    // Of the living units, counted as they are born, change weight and die.
+    std::uint64_t biomass    = 0;
+    std::size_t   population = 0;
+    
+    void sortUnits(Game &game);
+    
 public:
     League() {}
-    League(Game &game, const LeagueInfo &info);
+    League(Game &game, const std::string &name, const LeagueInfo &info, unsigned id, std::unordered_map<std::string, UnitKind> &&kinds);
+    
+    unsigned           getID()   const noexcept {return id;}
+    const std::string &getName() const noexcept {return name;}
     
     std::vector<Unit> units;
     Unit *getNextUnit();
     
-    std::uint64_t getTotalBiomass() const;
+    /*
+     * Called after each move; once every unit has had its move of the round,
+     * sorts the units every so often as the game's unit order says. Each
+     * unit still moves once per round.
+     */
+    void endMove(Game &game) {
+        if (nextUnitIndex == 0 && ++rounds % game.getUnitOrderInterval() == 0)
+            sortUnits(game);
+    }
+    
+    // Places a unit of the start kind on a free cell.
+    Unit &spawnUnit(Game &game, int x, int y);
+    
+    std::uint64_t getTotalBiomass() const noexcept {return biomass;}
+    std::size_t   getPopulation()   const noexcept {return population;}
 };
 
 static inline bool operator<(const League &a, const League &b) {
@@ -94,6 +445,8 @@ static inline bool operator<(const League &a, const League &b) {
  */
 
 class Unit {
+    friend Game;
+    
 public:
     enum class Direction {
         North = 0,
@@ -112,7 +465,10 @@ public:
         int getX() const {return x;}
         int getY() const {return y;}
         
-        void move(const Game &game, Direction dir);
+        // Stays put unless the next cell is free.
+        template <class Geometry>
+        void move(const Game &game, const Geometry &geometry, Direction dir);
+        
         void move(Direction dir);
         
         std::string stringValue();
@@ -140,11 +496,19 @@ public:
     
     //const Unit &operator=(const Unit &src) {return *this = Unit(src);}
     
+    // Through the game's BoardPaths.
     void execInsn(Game &game, League &league);
     
+    template <class Geometry>
+    void execInsn(Game &game, League &league, const Geometry &geometry);
+    
     const Position getPosition() const {return position;}
     
+    Direction getDirection() const      {return direction;}
+    void      setDirection(Direction dir) {direction = dir;}
+    
     Weight getWeight() const {return weight;}
+    void   setWeight(Game &game, Weight weight);
     bool isDead() const {return weight <= 0;}
     
     SpriteID getSpriteID() const {return sprite;}
@@ -157,6 +521,9 @@ private:
     
     Unit *findEnemy(Game &game);
     
+    template <class Geometry>
+    Unit *findEnemy(Game &game, const Geometry &geometry) const;
+    
     Direction direction = getRandomDirection();
     
     InsnRep insnRep;
@@ -164,10 +531,12 @@ private:
     
     Weight weight;
     
-    bool loseWeight(Game &game, Weight loss = 1);
+    template <class Geometry>
+    bool loseWeight(Game &game, const Geometry &geometry, Weight loss = 1);
     
-    void damage(Game &game, Weight attackerWeight) {
-        loseWeight(game, GetRandom(static_cast<std::uint32_t>(3 + attackerWeight / 2)));
+    template <class Geometry>
+    void damage(Game &game, const Geometry &geometry, Weight attackerWeight) {
+        loseWeight(game, geometry, GetRandom(static_cast<std::uint32_t>(3 + attackerWeight / 2)));
     }
     
     SpriteID sprite;
@@ -181,7 +550,7 @@ static inline Unit::Direction operator+(Unit::Direction dir, int offs) {
 }
 
 static inline Unit::Direction &operator+=(Unit::Direction &dir, int offs) {
-    return dir = dir + 1;
+    return dir = dir + offs;
 }
 
 static inline Unit::Direction &operator++(Unit::Direction &dir) {
@@ -195,11 +564,11 @@ static inline Unit::Direction operator++(Unit::Direction &dir, int) {
 }
 
 static inline Unit::Direction operator-(Unit::Direction dir, int offs) {
-    return static_cast<Unit::Direction>(std::abs((static_cast<int>(dir) - offs) % 4));
+    return static_cast<Unit::Direction>(((static_cast<int>(dir) - offs) % 4 + 4) % 4);
 }
 
 static inline Unit::Direction &operator-=(Unit::Direction &dir, int offs) {
-    return dir = dir - 1;
+    return dir = dir - offs;
 }
 
 static inline Unit::Direction &operator--(Unit::Direction &dir) {
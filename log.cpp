@@ -0,0 +1,401 @@
+#include "log.hpp"
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include "util.hpp"
+
+
+std::atomic<int>      LogRuntimeLevel{static_cast<int>(LogLevel::Off)};
+std::atomic<unsigned> LogRuntimeCategories{0};
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Record {
+    std::uint64_t time;
+    const char   *format;
+    LogLevel      level;
+    LogCategory   category;
+    std::uint8_t  argc;
+    LogArg        args[LogMaxArgs];
+};
+
+/*
+ * A single producer, single consumer ring of records. The producer is the
+ * owning thread, the consumer is the writer thread.
+ */
+class Ring {
+public:
+    static const std::size_t capacity = 1 << 14;
+    
+    bool push(const Record &record) {
+        auto h = head.load(std::memory_order_relaxed);
+        
+        if (h - tail.load(std::memory_order_acquire) == capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        
+        records[h % capacity] = record;
+        head.store(h + 1, std::memory_order_release);
+        
+        return true;
+    }
+    
+    bool pop(Record &record) {
+        auto t = tail.load(std::memory_order_relaxed);
+        
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        
+        record = records[t % capacity];
+        tail.store(t + 1, std::memory_order_release);
+        
+        return true;
+    }
+    
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<bool>          orphaned{false};
+    
+private:
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    
+    Record records[capacity];
+};
+
+struct Writer {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+    
+    std::thread thread;
+    std::atomic<bool> running{false};
+    
+    std::FILE *out = nullptr;
+    bool closeOut = false;
+    
+    LogFormat format = LogFormat::Text;
+    Clock::time_point start;
+    
+    // Binary output refers to format strings by number once they were defined.
+    std::unordered_map<const char *, std::uint32_t> formats;
+    
+    std::uint64_t dropped = 0;
+    
+    std::size_t drain();
+    void write(const Record &record);
+    void writeText(const Record &record);
+    void writeBinary(const Record &record);
+};
+
+Writer writer;
+
+// Marks the ring of a thread for removal when the thread ends.
+struct RingHandle {
+    std::shared_ptr<Ring> ring;
+    
+    ~RingHandle() {
+        if (ring)
+            ring->orphaned = true;
+    }
+};
+
+thread_local RingHandle localRing;
+
+Ring &getLocalRing() {
+    if (!localRing.ring) {
+        localRing.ring = std::make_shared<Ring>();
+        
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.rings.push_back(localRing.ring);
+    }
+    
+    return *localRing.ring;
+}
+
+std::size_t Writer::drain() {
+    std::vector<std::shared_ptr<Ring>> current;
+    std::size_t drained = 0;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = rings;
+    }
+    
+    Record record;
+    
+    for (auto &ring : current) {
+        while (ring->pop(record)) {
+            write(record);
+            drained++;
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    for (auto i = rings.begin(); i != rings.end();) {
+        // Anything pushed before the owner ended was drained above.
+        if ((*i)->orphaned) {
+            while ((*i)->pop(record))
+                write(record);
+            
+            dropped += (*i)->dropped;
+            i = rings.erase(i);
+        } else
+            ++i;
+    }
+    
+    return drained;
+}
+
+void Writer::write(const Record &record) {
+    if (format == LogFormat::Text)
+        writeText(record);
+    else
+        writeBinary(record);
+}
+
+void Writer::writeText(const Record &record) {
+    std::fprintf(
+        out, "%12.6f %-5s %-6s ",
+        record.time / 1e9, LogLevelName(record.level), LogCategoryName(record.category)
+    );
+    
+    int arg = 0;
+    
+    for (auto p = record.format; *p; p++) {
+        if (p[0] != '{' || p[1] != '}' || arg >= record.argc) {
+            std::fputc(*p, out);
+            continue;
+        }
+        
+        auto &a = record.args[arg++];
+        
+        switch (a.type) {
+            case LogArg::Int:
+                std::fprintf(out, "%lld", static_cast<long long>(a.i));
+                break;
+            case LogArg::Real:
+                std::fprintf(out, "%g", a.d);
+                break;
+            case LogArg::String:
+                std::fputs(a.s, out);
+                break;
+        }
+        
+        p++;
+    }
+    
+    std::fputc('\n', out);
+}
+
+/*
+ * Binary records, all integers little endian as on the host:
+ *
+ *   'F' u32 id, u32 length, bytes        defines format string 'id'
+ *   'R' u64 ns, u8 level, u8 category, u32 format id, u8 argc, args
+ *
+ * where every argument is a type byte followed by an i64, an f64, or a
+ * u32 length and the bytes of a string.
+ */
+void Writer::writeBinary(const Record &record) {
+    auto put = [this](const void *data, std::size_t size) {
+        std::fwrite(data, 1, size, out);
+    };
+    
+    auto putString = [&put](const char *s) {
+        std::uint32_t length = static_cast<std::uint32_t>(std::strlen(s));
+        put(&length, sizeof(length));
+        put(s, length);
+    };
+    
+    auto known = formats.find(record.format);
+    std::uint32_t id;
+    
+    if (known == formats.end()) {
+        id = static_cast<std::uint32_t>(formats.size());
+        formats[record.format] = id;
+        
+        std::fputc('F', out);
+        put(&id, sizeof(id));
+        putString(record.format);
+    } else
+        id = known->second;
+    
+    std::fputc('R', out);
+    put(&record.time, sizeof(record.time));
+    put(&record.level, 1);
+    put(&record.category, 1);
+    put(&id, sizeof(id));
+    put(&record.argc, 1);
+    
+    for (int i = 0; i < record.argc; i++) {
+        auto &a = record.args[i];
+        
+        put(&a.type, 1);
+        
+        switch (a.type) {
+            case LogArg::Int:
+                put(&a.i, sizeof(a.i));
+                break;
+            case LogArg::Real:
+                put(&a.d, sizeof(a.d));
+                break;
+            case LogArg::String:
+                putString(a.s);
+                break;
+        }
+    }
+}
+
+}
+
+void LogRecord(LogLevel level, LogCategory category, const char *format, const LogArg *args, int argc) {
+    Record record;
+    
+    record.time     = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - writer.start).count();
+    record.format   = format;
+    record.level    = level;
+    record.category = category;
+    record.argc     = static_cast<std::uint8_t>(argc);
+    
+    std::copy(args, args + argc, record.args);
+    
+    getLocalRing().push(record);
+}
+
+void LogStart(const std::string &path, const std::string &level, const std::string &categories, LogFormat format) {
+    auto minLevel = LogParseLevel(level);
+    auto mask     = LogParseCategories(categories);
+    
+    if (writer.running)
+        LogStop();
+    
+    if (path == "-") {
+        writer.out = stdout;
+        writer.closeOut = false;
+    } else {
+        if (!(writer.out = std::fopen(path.c_str(), format == LogFormat::Binary ? "wb" : "w")))
+            throw FileError(path.c_str());
+        
+        writer.closeOut = true;
+    }
+    
+    std::setvbuf(writer.out, nullptr, _IOFBF, 1 << 16);
+    
+    writer.format = format;
+    writer.start  = Clock::now();
+    writer.formats.clear();
+    writer.dropped = 0;
+    
+    if (format == LogFormat::Binary)
+        std::fputs("DGLOG1\n", writer.out);
+    
+    if (static_cast<int>(minLevel) < LOG_MIN_LEVEL)
+        std::cerr << "Log: records below '" << LogLevelName(static_cast<LogLevel>(LOG_MIN_LEVEL)) << "' were compiled out.\n";
+    
+    writer.running = true;
+    writer.thread = std::thread([] {
+        // Only an idle writer sleeps.
+        while (writer.running)
+            if (!writer.drain())
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    
+    LogRuntimeCategories = mask;
+    LogRuntimeLevel      = static_cast<int>(minLevel);
+}
+
+void LogStop() {
+    if (!writer.running)
+        return;
+    
+    LogRuntimeLevel = static_cast<int>(LogLevel::Off);
+    
+    writer.running = false;
+    writer.thread.join();
+    
+    writer.drain();
+    
+    std::uint64_t dropped = writer.dropped;
+    
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        
+        for (auto &ring : writer.rings)
+            dropped += ring->dropped.exchange(0);
+    }
+    
+    std::fflush(writer.out);
+    
+    if (writer.closeOut)
+        std::fclose(writer.out);
+    
+    writer.out = nullptr;
+    
+    if (dropped)
+        std::cerr << "Log: " << dropped << " record(s) dropped, the writer could not keep up.\n";
+}
+
+LogLevel LogParseLevel(const std::string &name) {
+    for (int i = 0; i <= static_cast<int>(LogLevel::Off); i++)
+        if (name == LogLevelName(static_cast<LogLevel>(i)))
+            return static_cast<LogLevel>(i);
+    
+    throw std::invalid_argument("Unknown log level: '" + name + "'.");
+}
+
+unsigned LogParseCategories(const std::string &names) {
+    unsigned mask = 0;
+    
+    std::size_t i = 0, d;
+    do {
+        d = names.find(',', i);
+        auto name = names.substr(i, d == std::string::npos ? std::string::npos : d - i);
+        
+        if (name == "all")
+            mask |= static_cast<unsigned>(LogCategory::All);
+        else {
+            unsigned found = 0;
+            
+            for (unsigned bit = 1; bit < static_cast<unsigned>(LogCategory::All); bit <<= 1)
+                if (name == LogCategoryName(static_cast<LogCategory>(bit)))
+                    found = bit;
+            
+            if (!found)
+                throw std::invalid_argument("Unknown log category: '" + name + "'.");
+            
+            mask |= found;
+        }
+        
+        i = d + 1;
+    } while (d != std::string::npos);
+    
+    return mask;
+}
+
+const char *LogLevelName(LogLevel level) {
+    static const char *names[] = {"trace", "debug", "info", "warn", "error", "off"};
+    return names[static_cast<int>(level)];
+}
+
+const char *LogCategoryName(LogCategory category) {
+    switch (category) {
+        case LogCategory::Sched:
+            return "sched";
+        case LogCategory::Insn:
+            return "insn";
+        case LogCategory::Combat:
+            return "combat";
+        default:
+            return "all";
+    }
+}
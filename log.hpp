@@ -0,0 +1,121 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+
+/*
+ * Trace logging.
+ *
+ *     LOG(Debug, Combat, "unit {} hit for {}", id, damage);
+ *
+ * Records below LOG_MIN_LEVEL are compiled out, arguments included. The
+ * rest cost a level/category check, and when enabled a copy into a ring
+ * buffer owned by the calling thread, from which a background thread
+ * writes them out as text or binary. When a ring is full, records are
+ * dropped and counted rather than waited for.
+ *
+ * Arguments are integers, floating point numbers or strings; strings are
+ * not copied and must outlive the logger (literals, DisasmOpcode(), ...).
+ */
+
+enum class LogLevel : std::uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+enum class LogCategory : std::uint8_t {
+    Sched  = 1 << 0,
+    Insn   = 1 << 1,
+    Combat = 1 << 2,
+    All    = Sched | Insn | Combat
+};
+
+enum class LogFormat {
+    Text,
+    Binary
+};
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+#define LOG(level, category, ...) \
+    do { \
+        if (static_cast<int>(LogLevel::level) >= LOG_MIN_LEVEL && \
+            LogEnabled(LogLevel::level, LogCategory::category)) \
+            LogWrite(LogLevel::level, LogCategory::category, __VA_ARGS__); \
+    } while (0)
+
+struct LogArg {
+    enum Type : std::uint8_t {
+        Int,
+        Real,
+        String
+    } type;
+    
+    union {
+        std::int64_t i;
+        double       d;
+        const char  *s;
+    };
+    
+    template <class T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+    LogArg(T value) : type(Int), i(static_cast<std::int64_t>(value)) {}
+    
+    LogArg()                         : type(Int),    i(0)     {}
+    LogArg(double value)             : type(Real),   d(value) {}
+    LogArg(const char *value)        : type(String), s(value) {}
+    LogArg(const std::string &value) : type(String), s(value.c_str()) {}
+};
+
+static const int LogMaxArgs = 6;
+
+extern std::atomic<int>      LogRuntimeLevel;
+extern std::atomic<unsigned> LogRuntimeCategories;
+
+static inline bool LogEnabled(LogLevel level, LogCategory category) {
+    return
+    static_cast<int>(level) >= LogRuntimeLevel.load(std::memory_order_relaxed) &&
+    (static_cast<unsigned>(category) & LogRuntimeCategories.load(std::memory_order_relaxed));
+}
+
+void LogRecord(LogLevel level, LogCategory category, const char *format, const LogArg *args, int argc);
+
+template <class... Args>
+static inline void LogWrite(LogLevel level, LogCategory category, const char *format, const Args &... args) {
+    static_assert(sizeof...(Args) <= LogMaxArgs, "Too many log arguments.");
+    
+    const LogArg packed[sizeof...(Args) + 1] = {LogArg(args)...};
+    LogRecord(level, category, format, packed, sizeof...(Args));
+}
+
+/*
+ * Starts the writer; path "-" is stdout. Nothing is logged before.
+ * Throws std::invalid_argument on bad level or category names.
+ */
+void LogStart(
+    const std::string &path,
+    const std::string &level = "trace",
+    const std::string &categories = "all",
+    LogFormat format = LogFormat::Text
+);
+
+// Drains everything logged so far and stops the writer.
+void LogStop();
+
+LogLevel    LogParseLevel(const std::string &name);
+unsigned    LogParseCategories(const std::string &names);
+const char *LogLevelName(LogLevel level);
+const char *LogCategoryName(LogCategory category);
+
+
+#endif
@@ -4,7 +4,19 @@
 #include <functional>
 #include <stdexcept>
 #include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
 #include "game.hpp"
+#include "frontend.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
+#include "test.hpp"
+#include "tournament.hpp"
+#include "server.hpp"
+#include "results.hpp"
 #include "util.hpp"
 
 
@@ -14,35 +26,148 @@ static void help_exit(const char *exec, int code) {
     "\n"
     "Usage: " << exec << " [options]\n"
     "\n"
-    "Game setup files must be in the current working directory.\n"
+    "Game setup files must be in the current working directory. A config.json\n"
+    "with 'tests' runs the scenario tests it describes instead, and one with\n"
+    "'tournament' plays its leagues against each other.\n"
     "\n"
     "Options:\n"
     " -help              show this help text\n"
+    " -test PATH         run the scenario tests in PATH and exit\n"
+    " -tournament PATH   play the tournament in PATH and exit\n"
+    " -serve             play the matches requested on stdin, see server.hpp\n"
+    " -serve-queue N     let up to N requests wait for a worker (default: 2 per job)\n"
+    " -jobs N            run N tests or games at a time (default: one per CPU)\n"
     " -sprite-size WxH   set sprite size overriding configuration\n"
-    " -move-delay DELAY  set the delay between moves\n";
+    " -move-delay DELAY  set the delay between moves\n"
+    " -rate N            run N moves per second, 0 for unlimited\n"
+    " -rate-per-frame N  run N moves per rendered frame\n"
+    " -unlimited         run moves as fast as possible\n"
+    " -headless          run without a window or display server\n"
+    " -quantum K         let a unit make K moves in a row (default 1)\n"
+    " -batch M           let M units of a league move per turn (default 1)\n"
+    " -seed N            make the game reproducible, N > 0\n"
+    " -stalemate-window N  end cycles and steady states, looking N moves back\n"
+    " -capture PATH      record the board to PATH ('-' for stdout)\n"
+    " -capture-every K   record a frame every K moves\n"
+    " -capture-format F  record as 'y4m' (default) or raw 'rgb'\n"
+    " -results PATH      append a record of every game to PATH ('-' for stdout)\n"
+    " -results-format F  write records as 'json' (default) or 'csv'\n"
+    " -timeline-every K  add the biomass and population every K moves to records\n"
+    " -log PATH          write trace records to PATH ('-' for stdout)\n"
+    " -log-level LEVEL   trace, debug (default), info, warn or error\n"
+    " -log-categories C  comma separated: sched, insn, combat or all\n"
+    " -log-format F      write records as 'text' (default) or 'binary'\n"
+    " -metrics PATH      append JSON metric snapshots to PATH\n"
+    " -metrics-interval S  take a snapshot every S seconds (default 10)\n"
+    " -profile PATH      write a bytecode profile to PATH at the end ('-' for stdout)\n"
+    " -trace PATH        write a Chrome trace_event timeline to PATH at the end\n"
+    " -trace-buffer N    keep up to N trace events per thread (default 1048576)\n"
+    "\n"
+    "Keys:\n"
+    " F                  toggle fast-forward\n"
+    " [ ]                halve or double the move rate\n"
+    " arrows, drag       pan the view\n"
+    " wheel, = -         zoom in or out\n"
+    " 0                  fit the board into the window\n";
     
     std::exit(code);
 }
 
+static const char *next_arg(int argc, char *argv[], int &i) {
+    if (++i >= argc) {
+        std::cerr << "Argument expected after flag '" << argv[i - 1] << "'.\n";
+        help_exit(argv[0], 1);
+    }
+    
+    return argv[i];
+}
+
 int main(int argc, char *argv[]) {
     int spriteWidth  = -1;
     int spriteHeight = -1;
 
     int moveDelay = -1;
     
+    double movesPerSecond = -1;
+    int    movesPerFrame  = -1;
+    
+    bool headless = false;
+    
+    std::uint64_t seed = 0;
+    
+    int stalemateWindow = -1;
+    
+    int quantum = 0, batch = 0;
+    
+    std::string capturePath, captureFormat;
+    int captureInterval = -1;
+    
+    std::string resultsPath, resultsFormat;
+    int timelineInterval = -1;
+    
+    std::string logPath, logLevel = "debug", logCategories = "all";
+    LogFormat logFormat = LogFormat::Text;
+    
+    std::string metricsPath;
+    double metricsInterval = 10;
+    
+    std::string profilePath;
+    
+    std::string testPath, tournamentPath;
+    int         jobs = 0;
+    
+    bool serve      = false;
+    int  serveQueue = 0;
+    
+    std::string tracePath;
+    long        traceBuffer = 1 << 20;
+    
     for (int i = 1; i < argc; i++) {
         std::unordered_map<std::string, std::function<void()>> options = {
             {"-help", [argv] {
                 help_exit(argv[0], 0);
             }},
             
-            {"-sprite-size", [argv, argc, &i, &spriteWidth, &spriteHeight] {
-                if (++i >= argc) {
-                    std::cerr << "Argument expected after flag '-sprite-size'.\n";
+            {"-test", [argv, argc, &i, &testPath] {
+                testPath = next_arg(argc, argv, i);
+            }},
+            
+            {"-tournament", [argv, argc, &i, &tournamentPath] {
+                tournamentPath = next_arg(argc, argv, i);
+            }},
+            
+            {"-serve", [&serve] {
+                serve = true;
+            }},
+            
+            {"-serve-queue", [argv, argc, &i, &serveQueue] {
+                try {
+                    serveQueue = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    serveQueue = 0;
+                }
+                
+                if (serveQueue < 1) {
+                    std::cerr << "Flag '-serve-queue' value is invalid, it must be a positive integer.\n";
                     help_exit(argv[0], 1);
                 }
+            }},
+            
+            {"-jobs", [argv, argc, &i, &jobs] {
+                try {
+                    jobs = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    jobs = 0;
+                }
                 
-                std::string wh = argv[i];
+                if (jobs < 1) {
+                    std::cerr << "Flag '-jobs' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-sprite-size", [argv, argc, &i, &spriteWidth, &spriteHeight] {
+                std::string wh = next_arg(argc, argv, i);
                 
                 auto sep = wh.find('x');
                 
@@ -56,15 +181,206 @@ int main(int argc, char *argv[]) {
             }},
             
             {"-move-delay", [argv, argc, &i, &moveDelay] {
-                if (++i >= argc) {
-                    std::cerr << "Argument expected after flag '-move-delay'.\n";
+                try {
+                    moveDelay = std::atoi(next_arg(argc, argv, i));
+                } catch (const std::invalid_argument &) {
+                    std::cerr << "Flag '-move-delay' value is invalid, it must be an integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-rate", [argv, argc, &i, &movesPerSecond, &movesPerFrame] {
+                try {
+                    movesPerSecond = std::stod(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {}
+                
+                if (movesPerSecond < 0) {
+                    std::cerr << "Flag '-rate' value is invalid, it must be a non-negative number.\n";
                     help_exit(argv[0], 1);
                 }
                 
+                movesPerFrame = -1;
+            }},
+            
+            {"-rate-per-frame", [argv, argc, &i, &movesPerSecond, &movesPerFrame] {
                 try {
-                    moveDelay = std::atoi(argv[i]);
-                } catch (const std::invalid_argument &) {
-                    std::cerr << "Flag '-move-delay' value is invalid, it must be an integer.\n";
+                    movesPerFrame = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {}
+                
+                if (movesPerFrame < 1) {
+                    std::cerr << "Flag '-rate-per-frame' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+                
+                movesPerSecond = -1;
+            }},
+            
+            {"-unlimited", [&movesPerSecond, &movesPerFrame] {
+                movesPerSecond = 0;
+                movesPerFrame  = -1;
+            }},
+            
+            {"-headless", [&headless] {
+                headless = true;
+            }},
+            
+            {"-seed", [argv, argc, &i, &seed] {
+                try {
+                    seed = std::stoull(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {}
+                
+                if (!seed) {
+                    std::cerr << "Flag '-seed' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-quantum", [argv, argc, &i, &quantum] {
+                try {
+                    quantum = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    quantum = 0;
+                }
+                
+                if (quantum < 1) {
+                    std::cerr << "Flag '-quantum' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-batch", [argv, argc, &i, &batch] {
+                try {
+                    batch = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    batch = 0;
+                }
+                
+                if (batch < 1) {
+                    std::cerr << "Flag '-batch' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-stalemate-window", [argv, argc, &i, &stalemateWindow] {
+                try {
+                    stalemateWindow = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    stalemateWindow = -1;
+                }
+                
+                if (stalemateWindow < 0) {
+                    std::cerr << "Flag '-stalemate-window' value is invalid, it must be a non-negative integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-capture", [argv, argc, &i, &capturePath] {
+                capturePath = next_arg(argc, argv, i);
+            }},
+            
+            {"-capture-every", [argv, argc, &i, &captureInterval] {
+                try {
+                    captureInterval = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {}
+                
+                if (captureInterval < 1) {
+                    std::cerr << "Flag '-capture-every' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-capture-format", [argv, argc, &i, &captureFormat] {
+                captureFormat = next_arg(argc, argv, i);
+                
+                if (captureFormat != "y4m" && captureFormat != "rgb") {
+                    std::cerr << "Flag '-capture-format' value is invalid, it must be 'y4m' or 'rgb'.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-results", [argv, argc, &i, &resultsPath] {
+                resultsPath = next_arg(argc, argv, i);
+            }},
+            
+            {"-results-format", [argv, argc, &i, &resultsFormat] {
+                resultsFormat = next_arg(argc, argv, i);
+                
+                if (resultsFormat != "json" && resultsFormat != "csv") {
+                    std::cerr << "Flag '-results-format' value is invalid, it must be 'json' or 'csv'.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-timeline-every", [argv, argc, &i, &timelineInterval] {
+                try {
+                    timelineInterval = std::stoi(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {}
+                
+                if (timelineInterval < 1) {
+                    std::cerr << "Flag '-timeline-every' value is invalid, it must be a positive integer.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-log", [argv, argc, &i, &logPath] {
+                logPath = next_arg(argc, argv, i);
+            }},
+            
+            {"-log-level", [argv, argc, &i, &logLevel] {
+                logLevel = next_arg(argc, argv, i);
+            }},
+            
+            {"-log-categories", [argv, argc, &i, &logCategories] {
+                logCategories = next_arg(argc, argv, i);
+            }},
+            
+            {"-log-format", [argv, argc, &i, &logFormat] {
+                std::string format = next_arg(argc, argv, i);
+                
+                if (format == "text")
+                    logFormat = LogFormat::Text;
+                else if (format == "binary")
+                    logFormat = LogFormat::Binary;
+                else {
+                    std::cerr << "Flag '-log-format' value is invalid, it must be 'text' or 'binary'.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-metrics", [argv, argc, &i, &metricsPath] {
+                metricsPath = next_arg(argc, argv, i);
+            }},
+            
+            {"-metrics-interval", [argv, argc, &i, &metricsInterval] {
+                try {
+                    metricsInterval = std::stod(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    metricsInterval = -1;
+                }
+                
+                if (metricsInterval < 0) {
+                    std::cerr << "Flag '-metrics-interval' value is invalid, it must be a non-negative number.\n";
+                    help_exit(argv[0], 1);
+                }
+            }},
+            
+            {"-profile", [argv, argc, &i, &profilePath] {
+                profilePath = next_arg(argc, argv, i);
+            }},
+            
+            {"-trace", [argv, argc, &i, &tracePath] {
+                tracePath = next_arg(argc, argv, i);
+            }},
+            
+            {"-trace-buffer", [argv, argc, &i, &traceBuffer] {
+                try {
+                    traceBuffer = std::stol(next_arg(argc, argv, i));
+                } catch (const std::logic_error &) {
+                    traceBuffer = 0;
+                }
+                
+                if (traceBuffer < 1) {
+                    std::cerr << "Flag '-trace-buffer' value is invalid, it must be a positive integer.\n";
                     help_exit(argv[0], 1);
                 }
             }}
@@ -79,10 +395,23 @@ int main(int argc, char *argv[]) {
     }
     
     try {
-        UIInit();
-        std::atexit(UIQuit);
+        if (serve) {
+            RunServer(std::cin, std::cout, jobs, serveQueue);
+            return 0;
+        }
+        
+        auto parseStart = std::chrono::steady_clock::now();
+        
+        Config config(
+            !testPath.empty()       ? testPath :
+            !tournamentPath.empty() ? tournamentPath :
+                                      "config.json"
+        );
         
-        Config config("config.json");
+        double parseTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+        
+        if (config.isTestSuite())
+            return RunTests(config, std::cout, jobs) ? 0 : 1;
         
         if (spriteWidth > 0)
             config.setSpriteSize(spriteWidth, spriteHeight);
@@ -90,6 +419,87 @@ int main(int argc, char *argv[]) {
         if (moveDelay >= 0)
             config.setMoveDelay(moveDelay);
         
+        if (movesPerSecond >= 0)
+            config.setMovesPerSecond(movesPerSecond);
+        
+        if (movesPerFrame > 0)
+            config.setMovesPerFrame(movesPerFrame);
+        
+        if (headless)
+            config.setHeadless(true);
+        
+        if (seed)
+            config.setSeed(seed);
+        
+        if (stalemateWindow >= 0)
+            config.setStalemateWindow(stalemateWindow);
+        
+        if (quantum > 0)
+            config.setQuantum(quantum);
+        
+        if (batch > 0)
+            config.setBatch(batch);
+        
+        if (!resultsPath.empty())
+            config.setResultsPath(resultsPath);
+        
+        if (!resultsFormat.empty())
+            config.setResultsFormat(resultsFormat);
+        
+        if (timelineInterval > 0)
+            config.setTimelineInterval(timelineInterval);
+        
+        // Records on stdout must not be interleaved with text.
+        if (config.getResultsPath() == "-")
+            std::cout.rdbuf(std::cerr.rdbuf());
+        
+        if (config.isTournament()) {
+            RunTournament(config, std::cout, jobs);
+            return 0;
+        }
+        
+        if (!capturePath.empty())
+            config.setCapturePath(capturePath);
+        
+        if (captureInterval > 0)
+            config.setCaptureInterval(captureInterval);
+        
+        if (!captureFormat.empty())
+            config.setCaptureFormat(captureFormat);
+        
+        if (config.getCapturePath() == "-" && config.getResultsPath() == "-")
+            throw std::invalid_argument("Frames and records cannot both go to stdout.");
+        
+        // Frames on stdout must not be interleaved with text.
+        if (config.getCapturePath() == "-")
+            std::cout.rdbuf(std::cerr.rdbuf());
+        
+        std::unique_ptr<ResultWriter> results;
+        
+        if (!config.getResultsPath().empty())
+            results.reset(new ResultWriter(config.getResultsPath(), ResultWriter::parseFormat(config.getResultsFormat())));
+        
+        UIInit(!config.isHeadless());
+        std::atexit(UIQuit);
+        
+        if (!logPath.empty()) {
+            LogStart(logPath, logLevel, logCategories, logFormat);
+            std::atexit(LogStop);
+        }
+        
+        if (!metricsPath.empty()) {
+            MetricsStart(metricsPath, metricsInterval);
+            std::atexit(MetricsStop);
+        }
+        
+        if (!profilePath.empty())
+            ProfileStart();
+        
+        if (!tracePath.empty()) {
+            TraceStart(tracePath, traceBuffer);
+            std::atexit(TraceStop);
+        }
+        
         std::cout << "Dumping league information...\n";
         
         for (auto &kv : config.getLeagueInfo()) {
@@ -111,13 +521,48 @@ int main(int argc, char *argv[]) {
             }
         }
         
+        auto gameStart = std::chrono::steady_clock::now();
+        
         Game game(config);
-        game.start();
+        
+        auto &times = game.getLoadTimes();
+        
+        std::cout << std::fixed << std::setprecision(1) <<
+        "Loaded in " << (parseTime + times.loading + times.placement) * 1e3 << " ms: "
+        "config " << parseTime * 1e3 << " ms, " <<
+        times.unitKinds << " unit kinds " << times.loading * 1e3 << " ms on " << times.threads << " threads "
+        "(assembly " << times.assembly * 1e3 << " ms), "
+        "placement " << times.placement * 1e3 << " ms.\n" << std::defaultfloat;
+        
+        GameFrontend(game).start();
+        
+        if (results)
+            results->write(game, std::chrono::duration<double>(std::chrono::steady_clock::now() - gameStart).count());
+        
+        TraceStop();
+        MetricsStop();
+        LogStop();
+        
+        if (!profilePath.empty())
+            ProfileReport(profilePath);
         
         std::cout << "Finish!\n";
         
-        for (auto &kv : game.getLeagues())
-            std::cout << "- " << kv.first << ": " << kv.second.getTotalBiomass() << '\n';
+        auto result = game.getWinner().empty() ? std::string("a draw") : game.getWinner() + " wins";
+        
+        switch (game.getEnding()) {
+            case Game::Ending::Cycle:
+                std::cout << "Stalemate after " << game.getMove() << " moves, the board repeats every " << game.getCyclePeriod() << " moves: " << result << ".\n";
+                break;
+            case Game::Ending::SteadyState:
+                std::cout << "Steady state after " << game.getMove() << " moves: " << result << ".\n";
+                break;
+            default:
+                break;
+        }
+        
+        for (auto id : game.getActiveLeagues())
+            std::cout << "- " << game.getLeagues()[id].getName() << ": " << game.getLeagues()[id].getTotalBiomass() << '\n';
     } catch (const std::exception &exc) {
         std::cout << exc.what() << std::endl;
         return 1;
@@ -0,0 +1,255 @@
+#include "metrics.hpp"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <json/json.h>
+#include "util.hpp"
+
+
+std::atomic<bool> MetricsActive{false};
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char *counterNames[] = {
+    "moves",
+    "instructions",
+    "pseudoDispatches",
+    "madPenalties",
+    "framesRendered",
+    "framesSkipped"
+};
+
+const char *histogramNames[] = {
+    "dispatchesPerMove",
+    "frameTimeMicros",
+    "renderLagMicros"
+};
+
+static_assert(sizeof(counterNames)   / sizeof(*counterNames)   == static_cast<unsigned>(Metric::Count),          "");
+static_assert(sizeof(histogramNames) / sizeof(*histogramNames) == static_cast<unsigned>(MetricHistogram::Count), "");
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<MetricsBlock>> blocks;
+    
+    std::string path;
+    double interval = 0;
+    
+    std::thread thread;
+    std::condition_variable wakeup;
+    bool stopping = false;
+    
+    Clock::time_point start, last;
+    std::uint64_t lastCounters[static_cast<unsigned>(Metric::Count)] = {};
+    
+    void snapshot();
+};
+
+Registry registry;
+
+thread_local std::shared_ptr<MetricsBlock> localBlock;
+
+void Registry::snapshot() {
+    const unsigned counterCount   = static_cast<unsigned>(Metric::Count);
+    const unsigned histogramCount = static_cast<unsigned>(MetricHistogram::Count);
+    
+    std::uint64_t counters[counterCount] = {};
+    
+    struct Total {
+        std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(MetricsBlock::buckets, 0);
+        std::uint64_t sum = 0, max = 0, count = 0;
+    } histograms[histogramCount];
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        
+        for (auto &block : blocks) {
+            for (unsigned i = 0; i < counterCount; i++)
+                counters[i] += block->counters[i].load(std::memory_order_relaxed);
+            
+            for (unsigned i = 0; i < histogramCount; i++) {
+                auto &from = block->histograms[i];
+                auto &to   = histograms[i];
+                
+                for (unsigned b = 0; b < MetricsBlock::buckets; b++) {
+                    auto n = from.counts[b].load(std::memory_order_relaxed);
+                    
+                    to.counts[b] += n;
+                    to.count     += n;
+                }
+                
+                to.sum += from.sum.load(std::memory_order_relaxed);
+                to.max  = std::max(to.max, from.max.load(std::memory_order_relaxed));
+            }
+        }
+    }
+    
+    auto now = Clock::now();
+    
+    const double elapsed = std::chrono::duration<double>(now - start).count();
+    const double window  = std::chrono::duration<double>(now - last).count();
+    
+    Json::Value root;
+    root["time"] = elapsed;
+    
+    for (unsigned i = 0; i < counterCount; i++) {
+        root["counters"][counterNames[i]] = Json::UInt64(counters[i]);
+        
+        // Rates cover the time since the previous snapshot.
+        if (window > 0)
+            root["rates"][counterNames[i]] = (counters[i] - lastCounters[i]) / window;
+        
+        lastCounters[i] = counters[i];
+    }
+    
+    for (unsigned i = 0; i < histogramCount; i++) {
+        auto &h = histograms[i];
+        auto &out = root["histograms"][histogramNames[i]];
+        
+        out["count"] = Json::UInt64(h.count);
+        out["sum"]   = Json::UInt64(h.sum);
+        out["max"]   = Json::UInt64(h.max);
+        out["mean"]  = h.count ? static_cast<double>(h.sum) / h.count : 0.0;
+        
+        auto percentile = [&h](double p) -> std::uint64_t {
+            std::uint64_t rank = static_cast<std::uint64_t>(p * h.count), seen = 0;
+            
+            for (unsigned b = 0; b < MetricsBlock::buckets; b++)
+                if ((seen += h.counts[b]) > rank)
+                    return std::min(MetricsBlock::bucketLimit(b), h.max);
+            
+            return h.max;
+        };
+        
+        out["p50"] = Json::UInt64(percentile(0.5));
+        out["p90"] = Json::UInt64(percentile(0.9));
+        out["p99"] = Json::UInt64(percentile(0.99));
+    }
+    
+    last = now;
+    
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    
+    std::ofstream out(path, std::ios::app);
+    if (!out)
+        throw FileError(path.c_str());
+    
+    // One snapshot per line.
+    out << Json::writeString(builder, root) << '\n';
+}
+
+}
+
+unsigned MetricsBlock::bucketOf(std::uint64_t value) {
+    if (value < exact)
+        return static_cast<unsigned>(value);
+    
+    unsigned e = 63 - __builtin_clzll(value);
+    
+    return exact + (e - 6) * 8 + ((value >> (e - 3)) & 7);
+}
+
+std::uint64_t MetricsBlock::bucketLimit(unsigned bucket) {
+    if (bucket < exact)
+        return bucket;
+    
+    unsigned e   = (bucket - exact) / 8 + 6;
+    unsigned sub = (bucket - exact) % 8;
+    
+    if (e == 63 && sub == 7)
+        return UINT64_MAX;
+    
+    return ((std::uint64_t)(8 + sub + 1) << (e - 3)) - 1;
+}
+
+MetricsBlock::MetricsBlock() {
+    for (auto &c : counters)
+        c = 0;
+    
+    for (auto &h : histograms) {
+        for (auto &c : h.counts)
+            c = 0;
+        
+        h.sum = h.max = 0;
+    }
+}
+
+MetricsBlock &MetricsLocalBlock() {
+    if (!localBlock) {
+        localBlock = std::make_shared<MetricsBlock>();
+        
+        // Blocks of finished threads stay, their counts are part of the totals.
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.blocks.push_back(localBlock);
+    }
+    
+    return *localBlock;
+}
+
+void MetricsStart(const std::string &path, double interval) {
+    MetricsStop();
+    
+    // Fail early on an unwritable path.
+    if (!std::ofstream(path, std::ios::app))
+        throw FileError(path.c_str());
+    
+    registry.path     = path;
+    registry.interval = interval;
+    registry.stopping = false;
+    registry.start    = registry.last = Clock::now();
+    
+    std::fill(std::begin(registry.lastCounters), std::end(registry.lastCounters), 0);
+    
+    MetricsActive = true;
+    
+    registry.thread = std::thread([] {
+        std::unique_lock<std::mutex> lock(registry.mutex);
+        
+        while (!registry.stopping) {
+            if (registry.interval > 0) {
+                auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(registry.interval));
+                
+                if (registry.wakeup.wait_for(lock, period, [] {return registry.stopping;}))
+                    break;
+                
+                lock.unlock();
+                
+                try {
+                    registry.snapshot();
+                } catch (const std::exception &exc) {
+                    std::cerr << "Metrics: " << exc.what() << '\n';
+                }
+                
+                lock.lock();
+            } else
+                registry.wakeup.wait(lock, [] {return registry.stopping;});
+        }
+    });
+}
+
+void MetricsStop() {
+    if (!registry.thread.joinable())
+        return;
+    
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.stopping = true;
+    }
+    
+    registry.wakeup.notify_all();
+    registry.thread.join();
+    
+    MetricsActive = false;
+    
+    registry.snapshot();
+}
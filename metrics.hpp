@@ -0,0 +1,95 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+
+/*
+ * Engine metrics.
+ *
+ * Counters and histograms are fixed at compile time and kept per thread,
+ * so recording is a plain load and store on memory no other thread writes.
+ * A background thread sums them up and appends a JSON snapshot to a file
+ * every few seconds and once more when stopped. Nothing is recorded
+ * before MetricsStart().
+ */
+
+enum class Metric : unsigned {
+    Moves,
+    Instructions,
+    PseudoDispatches,
+    MadPenalties,
+    FramesRendered,
+    FramesSkipped,
+    Count
+};
+
+enum class MetricHistogram : unsigned {
+    DispatchesPerMove,
+    FrameTimeMicros,
+    RenderLagMicros,
+    Count
+};
+
+class MetricsBlock;
+
+extern std::atomic<bool> MetricsActive;
+
+MetricsBlock &MetricsLocalBlock();
+
+class MetricsBlock {
+public:
+    // Values below 'exact' get a bucket each, larger ones 8 per power of two.
+    static const unsigned exact   = 64;
+    static const unsigned buckets = exact + (64 - 6) * 8;
+    
+    static unsigned bucketOf(std::uint64_t value);
+    static std::uint64_t bucketLimit(unsigned bucket);
+    
+    std::atomic<std::uint64_t> counters[static_cast<unsigned>(Metric::Count)];
+    
+    struct Histogram {
+        std::atomic<std::uint64_t> counts[buckets];
+        std::atomic<std::uint64_t> sum, max;
+    } histograms[static_cast<unsigned>(MetricHistogram::Count)];
+    
+    MetricsBlock();
+    
+    void add(Metric metric, std::uint64_t n) {
+        auto &c = counters[static_cast<unsigned>(metric)];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    
+    void observe(MetricHistogram histogram, std::uint64_t value) {
+        auto &h = histograms[static_cast<unsigned>(histogram)];
+        auto &c = h.counts[bucketOf(value)];
+        
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        h.sum.store(h.sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        
+        if (value > h.max.load(std::memory_order_relaxed))
+            h.max.store(value, std::memory_order_relaxed);
+    }
+};
+
+static inline void MetricsAdd(Metric metric, std::uint64_t n = 1) {
+    if (MetricsActive.load(std::memory_order_relaxed))
+        MetricsLocalBlock().add(metric, n);
+}
+
+static inline void MetricsObserve(MetricHistogram histogram, std::uint64_t value) {
+    if (MetricsActive.load(std::memory_order_relaxed))
+        MetricsLocalBlock().observe(histogram, value);
+}
+
+// Appends a snapshot to 'path' every 'interval' seconds; 0 only snapshots at the end.
+void MetricsStart(const std::string &path, double interval = 10);
+
+// Writes the final snapshot.
+void MetricsStop();
+
+
+#endif
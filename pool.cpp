@@ -0,0 +1,94 @@
+#include "pool.hpp"
+#include <atomic>
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (!threads)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; i++)
+        workers.emplace_back([this] {work();});
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    
+    wakeup.notify_all();
+    
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> &&task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    
+    wakeup.notify_one();
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] {return stopping || !tasks.empty();});
+            
+            // Whatever was queued is still run before stopping.
+            if (tasks.empty())
+                return;
+            
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t n, const std::function<void(std::size_t, std::size_t)> &fn, std::size_t grain) {
+    if (!n)
+        return;
+    
+    grain = std::max(grain, std::max<std::size_t>(1, n / (size() * 4 + 4)));
+    
+    const std::size_t chunks = (n + grain - 1) / grain;
+    
+    struct Shared {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    
+    auto shared = std::make_shared<Shared>();
+    
+    auto run = [shared, &fn, n, grain, chunks] {
+        std::size_t chunk;
+        while ((chunk = shared->next++) < chunks) {
+            fn(chunk * grain, std::min(n, (chunk + 1) * grain));
+            
+            if (++shared->done == chunks) {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->finished.notify_all();
+            }
+        }
+    };
+    
+    const std::size_t helpers = std::min(chunks, size() + 1) - 1;
+    for (std::size_t i = 0; i < helpers; i++)
+        enqueue(run);
+    
+    run();
+    
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->finished.wait(lock, [&shared, chunks] {return shared->done == chunks;});
+}
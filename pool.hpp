@@ -0,0 +1,64 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstddef>
+
+
+/*
+ * ThreadPool.
+ *
+ * A fixed set of workers taking tasks in FIFO order.
+ */
+
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread.
+    ThreadPool(std::size_t threads = 0);
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    
+    std::size_t size() const noexcept {return workers.size();}
+    
+    template <class F>
+    auto submit(F &&fn) -> std::future<decltype(fn())> {
+        auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::forward<F>(fn));
+        auto result = task->get_future();
+        
+        enqueue([task] {(*task)();});
+        
+        return result;
+    }
+    
+    /*
+     * Calls fn(begin, end) for consecutive chunks covering [0, n) and returns
+     * once all of them are done. The calling thread takes chunks as well, so
+     * this is safe to use from inside a task.
+     */
+    void parallelFor(std::size_t n, const std::function<void(std::size_t, std::size_t)> &fn, std::size_t grain = 1);
+    
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    
+    bool stopping = false;
+    
+    void enqueue(std::function<void()> &&task);
+    void work();
+};
+
+
+#endif
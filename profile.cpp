@@ -0,0 +1,256 @@
+#include "profile.hpp"
+#include <memory>
+#include <mutex>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include "util.hpp"
+
+
+std::atomic<bool> ProfileActive{false};
+
+namespace {
+
+struct Program {
+    std::string path;
+    Executable::Bytecode bytecode;
+    std::vector<int> lines;
+};
+
+struct ThreadProfile {
+    // Indexed by Executable::getID().
+    std::vector<std::unique_ptr<ProfileCounters>> counters;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadProfile>> threads;
+    std::unordered_map<std::uint32_t, Program> programs;
+};
+
+Registry registry;
+
+thread_local std::shared_ptr<ThreadProfile> localProfile;
+
+std::string disassemble(const Program &program, Executable::Word pc) {
+    auto &code = program.bytecode;
+    auto opcode = code[pc];
+    
+    std::ostringstream out;
+    out << DisasmOpcode(opcode);
+    
+    auto target = [&](Executable::Word address) {
+        if (address < program.lines.size())
+            out << " " << program.lines[address];
+        else
+            out << " @" << address;
+    };
+    
+    switch (opcode) {
+        case Executable::InsnEat:
+        case Executable::InsnGo:
+            if (code[pc + 1])
+                out << " " << code[pc + 1];
+            else
+                out << " r";
+            break;
+        case Executable::InsnStr:
+            out << " " << code[pc + 1];
+            break;
+        case Executable::InsnTurn:
+            out << " r";
+            break;
+        case Executable::InsnJG:
+        case Executable::InsnJL:
+            out << " " << code[pc + 1];
+            target(code[pc + 2]);
+            break;
+        case Executable::InsnJ:
+        case Executable::InsnJE:
+            target(code[pc + 1]);
+            break;
+    }
+    
+    return out.str();
+}
+
+// Counters of one program summed over threads and over parses of the same file.
+struct Merged {
+    const Program *program;
+    ProfileCounters counters;
+};
+
+void add(std::vector<std::uint64_t> &to, const std::vector<std::uint64_t> &from) {
+    for (std::size_t i = 0; i < to.size() && i < from.size(); i++)
+        to[i] += from[i];
+}
+
+}
+
+ProfileCounters *ProfileLocalCounters(const Executable &exec) {
+    if (!localProfile) {
+        localProfile = std::make_shared<ThreadProfile>();
+        
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(localProfile);
+    }
+    
+    auto id = exec.getID();
+    auto &counters = localProfile->counters;
+    
+    if (id >= counters.size())
+        counters.resize(id + 1);
+    
+    if (!counters[id]) {
+        std::unique_ptr<ProfileCounters> c(new ProfileCounters);
+        
+        for (auto v : {&c->dispatches, &c->repeats, &c->moves, &c->chains, &c->penalties})
+            v->resize(exec.size(), 0);
+        
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        
+        if (!registry.programs.count(id))
+            registry.programs[id] = {exec.getPath(), exec.getBytecode(), exec.getLines()};
+        
+        counters[id] = std::move(c);
+    }
+    
+    return counters[id].get();
+}
+
+void ProfileStart() {
+    ProfileActive = true;
+}
+
+void ProfileReport(const std::string &path) {
+    ProfileActive = false;
+    
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    
+    std::map<std::string, Merged> merged;
+    
+    for (auto &thread : registry.threads) {
+        for (std::uint32_t id = 0; id < thread->counters.size(); id++) {
+            auto &from = thread->counters[id];
+            if (!from)
+                continue;
+            
+            auto &program = registry.programs[id];
+            
+            // A file edited between parses is reported separately.
+            auto key = program.path;
+            auto it  = merged.find(key);
+            
+            if (it != merged.end() && it->second.program->bytecode != program.bytecode)
+                it = merged.find(key += " #" + std::to_string(id));
+            
+            if (it == merged.end()) {
+                it = merged.emplace(key, Merged{&program, {}}).first;
+                
+                auto &c = it->second.counters;
+                for (auto v : {&c.dispatches, &c.repeats, &c.moves, &c.chains, &c.penalties})
+                    v->resize(program.bytecode.size(), 0);
+            }
+            
+            auto &to = it->second.counters;
+            
+            add(to.dispatches, from->dispatches);
+            add(to.repeats,    from->repeats);
+            add(to.moves,      from->moves);
+            add(to.chains,     from->chains);
+            add(to.penalties,  from->penalties);
+            
+            for (unsigned i = 0; i < ProfileCounters::classes; i++) {
+                to.samples[i] += from->samples[i];
+                to.nanos[i]   += from->nanos[i];
+            }
+        }
+    }
+    
+    std::ofstream file;
+    
+    if (path != "-") {
+        file.open(path);
+        if (!file)
+            throw FileError(path.c_str());
+    }
+    
+    std::ostream &out = path == "-" ? std::cout : file;
+    
+    std::uint64_t executed[ProfileCounters::classes] = {}, samples[ProfileCounters::classes] = {}, nanos[ProfileCounters::classes] = {};
+    
+    for (auto &kv : merged) {
+        auto &program = *kv.second.program;
+        auto &c = kv.second.counters;
+        
+        std::uint64_t dispatches = 0, repeats = 0, moves = 0, penalties = 0;
+        
+        for (std::size_t pc = 0; pc < c.dispatches.size(); pc++) {
+            dispatches += c.dispatches[pc];
+            repeats    += c.repeats[pc];
+            moves      += c.moves[pc];
+            penalties  += c.penalties[pc];
+            
+            auto opcode = program.bytecode[pc];
+            
+            if (c.dispatches[pc] && opcode <= Executable::InsnMax)
+                executed[opcode] += c.dispatches[pc];
+            
+            if (c.repeats[pc])
+                executed[ProfileCounters::repeatClass(opcode)] += c.repeats[pc];
+        }
+        
+        for (unsigned i = 0; i < ProfileCounters::classes; i++) {
+            samples[i] += c.samples[i];
+            nanos[i]   += c.nanos[i];
+        }
+        
+        out <<
+        kv.first << ": " << moves + repeats << " moves, " << repeats << " repeated, " <<
+        dispatches << " dispatches, " << penalties << " mad penalties\n\n"
+        "  line    pc  instruction      dispatches      %    repeats      moves  chain        mad\n";
+        
+        for (std::size_t pc = 0; pc < program.bytecode.size(); ) {
+            out << std::right <<
+            std::setw(6)  << program.lines[pc] <<
+            std::setw(6)  << pc << "  " <<
+            std::left  << std::setw(14) << disassemble(program, pc) <<
+            std::right << std::setw(13) << c.dispatches[pc] <<
+            std::setw(7)  << std::fixed << std::setprecision(1) << (dispatches ? 100.0 * c.dispatches[pc] / dispatches : 0) <<
+            std::setw(11) << c.repeats[pc] <<
+            std::setw(11) << c.moves[pc] <<
+            std::setw(7)  << std::setprecision(2) << (c.moves[pc] ? double(c.chains[pc]) / c.moves[pc] : 0) <<
+            std::setw(11) << c.penalties[pc] << '\n';
+            
+            // Words up to the next line belong to this instruction.
+            auto line = program.lines[pc];
+            while (pc < program.bytecode.size() && program.lines[pc] == line)
+                pc++;
+        }
+        
+        out << '\n';
+    }
+    
+    out << "Time per opcode, from one move in 64:\n\n"
+    "  opcode        executed    est. ms  ns each\n";
+    
+    static const Executable::Word repeatable[] = {Executable::InsnEat, Executable::InsnGo, Executable::InsnStr};
+    
+    for (unsigned i = 0; i < ProfileCounters::classes; i++) {
+        if (!executed[i])
+            continue;
+        
+        std::string name = i <= Executable::InsnMax ? DisasmOpcode(i) : "rep " + DisasmOpcode(repeatable[i - Executable::InsnMax - 1]);
+        
+        double each = samples[i] ? double(nanos[i]) / samples[i] : 0;
+        
+        out <<
+        "  " << std::left << std::setw(10) << name <<
+        std::right << std::setw(12) << executed[i] <<
+        std::setw(11) << std::fixed << std::setprecision(1) << each * executed[i] / 1e6 <<
+        std::setw(9)  << std::setprecision(0) << each << '\n';
+    }
+}
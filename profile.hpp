@@ -0,0 +1,143 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "executable.hpp"
+
+
+/*
+ * Bytecode profiler.
+ *
+ * Counts, per program and pc, dispatches, repeated moves, the pseudo
+ * instructions run before each move's real one and mad penalties, and
+ * times the handlers of one move in 64 to estimate the time spent per
+ * opcode. Counters are per thread and are merged by ProfileReport(),
+ * which prints them next to the disassembly and the .dasm line numbers.
+ * Nothing is counted before ProfileStart().
+ */
+
+extern std::atomic<bool> ProfileActive;
+
+struct ProfileCounters {
+    // One opcode class per opcode, then one per repeated instruction.
+    static const unsigned classes = Executable::InsnMax + 1 + 3;
+    
+    static unsigned repeatClass(Executable::Word opcode) {
+        return Executable::InsnMax + 1 + (opcode == Executable::InsnEat ? 0 : opcode == Executable::InsnGo ? 1 : 2);
+    }
+    
+    std::vector<std::uint64_t> dispatches, repeats, moves, chains, penalties;
+    
+    std::uint64_t samples[classes] = {}, nanos[classes] = {};
+    std::uint32_t sampler = 2463534242u;
+};
+
+ProfileCounters *ProfileLocalCounters(const Executable &exec);
+
+// Records one move of a unit running 'exec'.
+class ProfileMove {
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    ProfileCounters *counters = nullptr;
+    const Executable &exec;
+    
+    Executable::Word start = 0;
+    unsigned pseudo = 0;
+    bool     first  = true;
+    
+    bool timed = false;
+    unsigned timedClass = 0;
+    Clock::time_point timedStart;
+    
+    void stopTimer() {
+        counters->nanos[timedClass] += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - timedStart).count();
+        counters->samples[timedClass]++;
+    }
+    
+public:
+    explicit ProfileMove(const Executable &exec) : exec(exec) {
+        if (ProfileActive.load(std::memory_order_relaxed)) {
+            counters = ProfileLocalCounters(exec);
+            // Xorshift, so that programs with a period do not alias with the sampling.
+            auto &x = counters->sampler;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            
+            timed = (x & 63) == 0;
+        }
+    }
+    
+    ~ProfileMove() {
+        if (!counters || first)
+            return;
+        
+        counters->moves[start]++;
+        counters->chains[start] += pseudo;
+    }
+    
+    // A move repeating the instruction before 'pc'.
+    void repeat(Executable::Word pc) {
+        if (!counters)
+            return;
+        
+        auto at = (pc ? pc : exec.size()) - 2;
+        counters->repeats[at]++;
+        
+        if (timed) {
+            timedClass = ProfileCounters::repeatClass(exec[at]);
+            timedStart = Clock::now();
+        }
+    }
+    
+    void dispatch(Executable::Word pc, Executable::Word opcode) {
+        if (!counters)
+            return;
+        
+        if (first) {
+            start = pc;
+            first = false;
+        }
+        
+        counters->dispatches[pc]++;
+        
+        if (timed) {
+            timedClass = opcode;
+            timedStart = Clock::now();
+        }
+    }
+    
+    void dispatched(bool isPseudo) {
+        if (!counters)
+            return;
+        
+        pseudo += isPseudo;
+        
+        if (timed)
+            stopTimer();
+    }
+    
+    void repeated() {
+        if (counters && timed)
+            stopTimer();
+    }
+    
+    void penalty() {
+        if (counters)
+            counters->penalties[start]++;
+    }
+};
+
+void ProfileStart();
+
+// Writes the merged counters as annotated disassembly, '-' for stdout.
+void ProfileReport(const std::string &path);
+
+
+#endif
@@ -0,0 +1,222 @@
+#include "results.hpp"
+#include <stdexcept>
+#include "util.hpp"
+
+
+const char *EndingName(Game::Ending ending) {
+    switch (ending) {
+        case Game::Ending::Elimination:
+            return "elimination";
+        case Game::Ending::Cycle:
+            return "cycle";
+        case Game::Ending::SteadyState:
+            return "steady-state";
+        default:
+            return "none";
+    }
+}
+
+Json::Value MatchResult(const Game &game, double seconds) {
+    Json::Value result;
+    result["seed"]    = Json::UInt64(game.getConfig().getSeed());
+    result["seconds"] = seconds;
+    result["moves"]   = game.getMove();
+    result["ending"]  = EndingName(game.getEnding());
+    result["winner"]  = game.getWinner().empty() ? Json::Value() : Json::Value(game.getWinner());
+    
+    auto &leagues = game.getLeagues();
+    
+    for (auto &league : leagues) {
+        result["biomass"][league.getName()]    = Json::UInt64(league.getTotalBiomass());
+        result["population"][league.getName()] = Json::UInt64(league.getPopulation());
+    }
+    
+    auto &timeline = game.getTimeline();
+    
+    if (timeline.interval) {
+        auto &json = result["timeline"];
+        json["interval"] = timeline.interval;
+        json["moves"]    = Json::Value(Json::arrayValue);
+        
+        for (auto move : timeline.moves)
+            json["moves"].append(move);
+        
+        for (std::size_t id = 0; id < leagues.size(); id++) {
+            auto &biomass    = json["biomass"][leagues[id].getName()]    = Json::Value(Json::arrayValue);
+            auto &population = json["population"][leagues[id].getName()] = Json::Value(Json::arrayValue);
+            
+            for (std::size_t i = id; i < timeline.biomass.size(); i += leagues.size()) {
+                biomass.append(Json::UInt64(timeline.biomass[i]));
+                population.append(Json::UInt64(timeline.population[i]));
+            }
+        }
+    }
+    
+    return result;
+}
+
+/*
+ * ResultWriter.
+ */
+
+// Records are small; this keeps a batch of games from writing every one on its own.
+static const std::size_t bufferSize = 1 << 20;
+
+ResultWriter::Format ResultWriter::parseFormat(const std::string &name) {
+    if (name == "json")
+        return Format::JSON;
+    
+    if (name == "csv")
+        return Format::CSV;
+    
+    throw std::invalid_argument("Unknown results format: '" + name + "'.");
+}
+
+ResultWriter::ResultWriter(const std::string &path, Format format) : format(format) {
+    if (path == "-") {
+        // Buffered here, as stdout may have been written to already and so cannot be given a buffer.
+        out = stdout;
+        closeOut = false;
+        header = true;
+        
+        pending.reserve(bufferSize);
+    } else {
+        if (!(out = std::fopen(path.c_str(), "ab")))
+            throw FileError(path.c_str());
+        
+        closeOut = true;
+        
+        std::setvbuf(out, nullptr, _IOFBF, bufferSize);
+        
+        std::fseek(out, 0, SEEK_END);
+        header = std::ftell(out) == 0;
+    }
+    
+    writer["indentation"] = "";
+    writer["precision"]   = 6;
+}
+
+ResultWriter::~ResultWriter() {
+    finish();
+}
+
+void ResultWriter::write(const Game &game, double seconds) {
+    if (format == Format::CSV)
+        return writeCSV(game, seconds);
+    
+    auto line = Json::writeString(writer, MatchResult(game, seconds));
+    
+    line += '\n';
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    put(line);
+}
+
+void ResultWriter::put(const std::string &data) {
+    if (closeOut)
+        std::fwrite(data.data(), 1, data.size(), out);
+    else {
+        pending += data;
+        
+        if (pending.size() >= bufferSize) {
+            std::fwrite(pending.data(), 1, pending.size(), out);
+            pending.clear();
+        }
+    }
+}
+
+// Quoted only when it has to be.
+static std::string CSVField(const std::string &value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos)
+        return value;
+    
+    std::string quoted = "\"";
+    
+    for (auto c : value) {
+        if (c == '"')
+            quoted += '"';
+        
+        quoted += c;
+    }
+    
+    return quoted + '"';
+}
+
+void ResultWriter::writeCSV(const Game &game, double seconds) {
+    auto &leagues  = game.getLeagues();
+    auto &timeline = game.getTimeline();
+    
+    // Samples of one league, separated by spaces.
+    auto samples = [&leagues](const std::vector<std::uint64_t> &values, std::size_t id) {
+        std::string field;
+        
+        for (std::size_t i = id; i < values.size(); i += leagues.size()) {
+            if (!field.empty())
+                field += ' ';
+            
+            field += std::to_string(values[i]);
+        }
+        
+        return field;
+    };
+    
+    char time[32];
+    std::snprintf(time, sizeof time, "%.6g", seconds);
+    
+    std::string row =
+    std::to_string(game.getConfig().getSeed()) + ',' + time + ',' + std::to_string(game.getMove()) + ',' +
+    EndingName(game.getEnding()) + ',' + CSVField(game.getWinner());
+    
+    for (auto &league : leagues)
+        row += ',' + CSVField(league.getName()) + ',' + std::to_string(league.getTotalBiomass()) + ',' + std::to_string(league.getPopulation());
+    
+    if (timeline.interval) {
+        row += ',';
+        
+        for (std::size_t i = 0; i < timeline.moves.size(); i++)
+            row += (i ? " " : "") + std::to_string(timeline.moves[i]);
+        
+        for (std::size_t id = 0; id < leagues.size(); id++)
+            row += ',' + samples(timeline.biomass, id) + ',' + samples(timeline.population, id);
+    }
+    
+    row += '\n';
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (header) {
+        std::string names = "seed,seconds,moves,ending,winner";
+        
+        for (std::size_t i = 1; i <= leagues.size(); i++)
+            names += ",league" + std::to_string(i) + ",biomass" + std::to_string(i) + ",population" + std::to_string(i);
+        
+        if (timeline.interval) {
+            names += ",timelineMoves";
+            
+            for (std::size_t i = 1; i <= leagues.size(); i++)
+                names += ",biomassTimeline" + std::to_string(i) + ",populationTimeline" + std::to_string(i);
+        }
+        
+        put(names + '\n');
+        header = false;
+    }
+    
+    put(row);
+}
+
+void ResultWriter::finish() {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (!out)
+        return;
+    
+    std::fwrite(pending.data(), 1, pending.size(), out);
+    pending.clear();
+    
+    std::fflush(out);
+    
+    if (closeOut)
+        std::fclose(out);
+    
+    out = nullptr;
+}
@@ -0,0 +1,77 @@
+#ifndef RESULTS_HPP
+#define RESULTS_HPP
+
+
+#include <string>
+#include <mutex>
+#include <cstdio>
+#include <json/json.h>
+#include "game.hpp"
+
+
+/*
+ * Match results.
+ *
+ * One record per match for batch analysis: 'seed', 'seconds', 'moves',
+ * 'ending', 'winner' and the final 'biomass' and 'population' of every
+ * league, with the timeline of both when the config has a timeline
+ * interval (see Game::Timeline). Records are made from the leagues'
+ * counters, not from a pass over the units.
+ *
+ * As JSON, a record is an object on one line:
+ *
+ *   {"seed": 2, "seconds": 0.05, "moves": 31337, "ending": "elimination", "winner": "bees",
+ *    "biomass": {"bees": 120, "chickens": 0}, "population": {"bees": 24, "chickens": 0},
+ *    "timeline": {"interval": 1000, "moves": [0, 1000, ...], "biomass": {"bees": [100, ...], ...}, "population": {...}}}
+ *
+ * As CSV, a row of seed,seconds,moves,ending,winner followed by
+ * league<i>,biomass<i>,population<i> for every league in id order and, with
+ * a timeline, by timelineMoves and biomassTimeline<i>,populationTimeline<i>,
+ * whose samples are separated by spaces. The header is written to a new or
+ * empty file only, after the first record's leagues.
+ */
+
+const char *EndingName(Game::Ending ending);
+
+// The JSON record of a game played for 'seconds'.
+Json::Value MatchResult(const Game &game, double seconds);
+
+class ResultWriter {
+public:
+    enum class Format {
+        JSON,
+        CSV
+    };
+    
+    static Format parseFormat(const std::string &name);
+    
+    // Appends to 'path', '-' for stdout, through a large buffer that finish() flushes.
+    ResultWriter(const std::string &path, Format format);
+    ~ResultWriter();
+    
+    // May be called from several threads.
+    void write(const Game &game, double seconds);
+    void finish();
+    
+private:
+    Format format;
+    
+    std::FILE *out;
+    bool closeOut;
+    bool header;
+    
+    std::mutex mutex;
+    
+    // What is still to be written to stdout; files are buffered by stdio.
+    std::string pending;
+    
+    Json::StreamWriterBuilder writer;
+    
+    // Needs the mutex.
+    void put(const std::string &data);
+    
+    void writeCSV(const Game &game, double seconds);
+};
+
+
+#endif
@@ -0,0 +1,201 @@
+#include "server.hpp"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <unordered_map>
+#include <exception>
+#include <json/json.h>
+#include "config.hpp"
+#include "executable.hpp"
+#include "game.hpp"
+#include "pool.hpp"
+#include "results.hpp"
+#include "util.hpp"
+
+
+namespace {
+
+// Beyond this many configs the cache starts over.
+const std::size_t maxCachedConfigs = 256;
+
+class Server {
+private:
+    std::ostream &out;
+    std::mutex    outMutex;
+    
+    Json::StreamWriterBuilder writer;
+    
+    // Configs read from a file are read again once its FileStamp() has changed.
+    struct CachedConfig {
+        std::string stamp;
+        std::shared_ptr<const Config> config;
+    };
+    
+    std::mutex configMutex;
+    std::unordered_map<std::string, CachedConfig> configs;
+    
+    ExecutableCache executables;
+    
+    std::shared_ptr<const Config> getConfig(const Json::Value &value);
+    
+public:
+    Server(std::ostream &out) : out(out) {
+        writer["indentation"] = "";
+        writer["precision"]   = 6;
+    }
+    
+    void write(const Json::Value &result);
+    
+    Json::Value play(const Json::Value &request);
+};
+
+std::shared_ptr<const Config> Server::getConfig(const Json::Value &value) {
+    if (!value.isNull() && !value.isString() && !value.isObject())
+        throw ConfigError("Member config must be a path or an object.");
+    
+    auto path = value.isString() ? value.asString() : std::string("config.json");
+    
+    // Written out, an object starts with a brace.
+    auto key   = value.isObject() ? Json::writeString(writer, value) : "path:" + path;
+    auto stamp = value.isObject() ? std::string() : FileStamp(path.c_str());
+    
+    {
+        std::lock_guard<std::mutex> lock(configMutex);
+        
+        auto it = configs.find(key);
+        if (it != configs.end() && it->second.stamp == stamp)
+            return it->second.config;
+    }
+    
+    std::shared_ptr<const Config> config(
+        value.isObject() ? new Config(value) : new Config(path)
+    );
+    
+    if (config->isTestSuite() || config->isTournament())
+        throw ConfigError("The config must be of a single game.");
+    
+    std::lock_guard<std::mutex> lock(configMutex);
+    
+    if (configs.size() >= maxCachedConfigs)
+        configs.clear();
+    
+    configs[key] = {std::move(stamp), config};
+    
+    return config;
+}
+
+void Server::write(const Json::Value &result) {
+    auto line = Json::writeString(writer, result);
+    
+    std::lock_guard<std::mutex> lock(outMutex);
+    out << line << '\n' << std::flush;
+}
+
+Json::Value Server::play(const Json::Value &request) {
+    auto start = std::chrono::steady_clock::now();
+    
+    // A copy, so that the seed and the programs stay with this match.
+    Config config(*getConfig(request["config"]));
+    
+    if (request.isMember("seed")) {
+        if (!request["seed"].isUInt64())
+            throw ConfigError("Member seed must be a non-negative integer.");
+        
+        config.setSeed(request["seed"].asUInt64());
+    }
+    
+    if (request.isMember("timelineInterval")) {
+        if (!request["timelineInterval"].isInt() || request["timelineInterval"].asInt() < 0)
+            throw ConfigError("Member timelineInterval must be a non-negative integer.");
+        
+        config.setTimelineInterval(request["timelineInterval"].asInt());
+    }
+    
+    if (request.isMember("maxMoves") && !request["maxMoves"].isInt())
+        throw ConfigError("Member maxMoves must be an integer.");
+    
+    int maxMoves = request.get("maxMoves", config.getMaxMoves()).asInt();
+    
+    auto &programs = request["programs"];
+    
+    if (!programs.isNull() && !programs.isObject())
+        throw ConfigError("Member programs must be an object.");
+    
+    for (auto &path : programs.getMemberNames()) {
+        if (!programs[path].isString())
+            throw ConfigError("Member programs." + path + " must be a string.");
+        
+        config.setProgram(path, programs[path].asString());
+    }
+    
+    Game game(config, &executables);
+    
+    SeedRandom(game.getMoveSeed());
+    
+    game.step(maxMoves - game.getMove());
+    
+    auto result = MatchResult(game, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    result["id"] = request["id"];
+    
+    return result;
+}
+
+}
+
+void RunServer(std::istream &in, std::ostream &out, unsigned threads, std::size_t queueSize) {
+    Server server(out);
+    
+    ThreadPool pool(threads);
+    
+    BoundedQueue<Json::Value> queue(queueSize ? queueSize : 2 * pool.size());
+    
+    std::vector<std::future<void>> workers;
+    
+    for (std::size_t i = 0; i < pool.size(); i++)
+        workers.push_back(pool.submit([&server, &queue] {
+            Json::Value request;
+            
+            while (queue.pop(request)) {
+                Json::Value result;
+                
+                try {
+                    result = server.play(request);
+                } catch (const std::exception &exc) {
+                    result = Json::Value();
+                    result["id"]    = request["id"];
+                    result["error"] = exc.what();
+                }
+                
+                server.write(result);
+            }
+        }));
+    
+    std::string line;
+    
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        
+        Json::Value request;
+        Json::Reader reader;
+        
+        if (!reader.parse(line, request) || !request.isObject()) {
+            Json::Value result;
+            result["id"]    = Json::Value();
+            result["error"] = "A request must be a JSON object on one line.";
+            
+            server.write(result);
+            continue;
+        }
+        
+        // Blocks while the queue is full, which in turn stops whoever is writing to 'in'.
+        queue.push(std::move(request));
+    }
+    
+    queue.close();
+    
+    for (auto &worker : workers)
+        worker.get();
+}
@@ -0,0 +1,34 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+
+#include <istream>
+#include <ostream>
+#include <cstddef>
+
+
+/*
+ * Server.
+ *
+ * Plays matches for as long as requests come in, one JSON object per line:
+ *
+ *   {"id": 1, "config": "path/to/config.json", "seed": 7}
+ *   {"id": 2, "config": {...}, "seed": 8, "maxMoves": 100000, "programs": {"bees/start.dasm": "eat\n"}}
+ *
+ * 'config' is a path or the config itself, "config.json" if left out, with
+ * league directories relative to the working directory. 'seed', 'maxMoves'
+ * and 'timelineInterval' default to the config's, and 'programs' gives
+ * executable sources in memory (see Config::setProgram()). Each result is
+ * written as one line once its match is over, so not in request order: 'id'
+ * and the record of results.hpp, or 'id' and 'error'.
+ *
+ * Parsed configs and assembled executables are kept between matches. At
+ * most 'queueSize' requests wait for a worker; beyond that, reading stops
+ * until one is free.
+ */
+
+// 0 threads means one per hardware thread, a queue size of 0 twice as many requests as threads.
+void RunServer(std::istream &in, std::ostream &out, unsigned threads = 0, std::size_t queueSize = 0);
+
+
+#endif
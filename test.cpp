@@ -0,0 +1,153 @@
+#include "test.hpp"
+#include <vector>
+#include <future>
+#include <chrono>
+#include <sstream>
+#include <exception>
+#include "game.hpp"
+#include "pool.hpp"
+
+
+static std::string describe(const UnitStateInfo &state) {
+    static const char *directions[] = {"north", "east", "south", "west"};
+    
+    std::ostringstream out;
+    out << "{script " << state.script << ", " << state.x << "," << state.y << ", weight " << state.weight;
+    
+    if (state.direction >= 0)
+        out << ", " << directions[state.direction];
+    
+    out << "}";
+    
+    return out.str();
+}
+
+static bool matches(const UnitStateInfo &expected, const UnitStateInfo &actual) {
+    return
+    (expected.x         < 0 || expected.x         == actual.x) &&
+    (expected.y         < 0 || expected.y         == actual.y) &&
+    (expected.weight    < 0 || expected.weight    == actual.weight) &&
+    (expected.direction < 0 || expected.direction == actual.direction) &&
+    (expected.script    < 0 || expected.script    == actual.script);
+}
+
+static std::string leagueName(std::size_t script) {
+    return "script" + std::to_string(script);
+}
+
+static std::string runTest(const Config &suite, const TestInfo &test) {
+    Json::Value root;
+    root["columnNumber"]   = test.columnNumber;
+    root["rowNumber"]      = test.rowNumber;
+    root["unitsPerLeague"] = 0;
+    root["headless"]       = true;
+    root["seed"]           = Json::UInt64(test.seed);
+    
+    for (std::size_t i = 0; i < test.scripts.size(); i++) {
+        auto &league = root["leagues"][leagueName(i)];
+        
+        league["directory"] = suite.getDirectory();
+        league["unitKinds"]["start"]["exec"]   = test.scripts[i];
+        league["unitKinds"]["start"]["sprite"] = "#808080";
+    }
+    
+    Config config(root);
+    Game game(config);
+    
+    for (auto &state : test.source) {
+        int x = state.x, y = state.y;
+        
+        if (x < 0 || y < 0)
+            game.getRandomLocation(x, y);
+        else if (!game.isFreePosition(x, y))
+            return "source unit " + describe(state) + " is not on a free cell";
+        
+        auto &unit = game.findLeague(leagueName(std::max(state.script, 0)))->spawnUnit(game, x, y);
+        
+        if (state.weight >= 0)
+            unit.setWeight(game, state.weight);
+        
+        if (state.direction >= 0)
+            unit.setDirection(static_cast<Unit::Direction>(state.direction));
+    }
+    
+    game.step(test.steps);
+    
+    std::vector<UnitStateInfo> result;
+    
+    for (std::size_t i = 0; i < test.scripts.size(); i++) {
+        auto league = game.findLeague(leagueName(i));
+        
+        for (auto &unit : league->units) {
+            if (unit.isDead())
+                continue;
+            
+            UnitStateInfo state;
+            state.x         = unit.getPosition().getX();
+            state.y         = unit.getPosition().getY();
+            state.weight    = unit.getWeight();
+            state.direction = static_cast<int>(unit.getDirection());
+            state.script    = static_cast<int>(i);
+            
+            result.push_back(state);
+        }
+    }
+    
+    if (result.size() != test.result.size())
+        return "expected " + std::to_string(test.result.size()) + " units, got " + std::to_string(result.size());
+    
+    for (std::size_t i = 0; i < result.size(); i++)
+        if (!matches(test.result[i], result[i]))
+            return "unit " + std::to_string(i) + ": expected " + describe(test.result[i]) + ", got " + describe(result[i]);
+    
+    return "";
+}
+
+TestResult RunTest(const Config &suite, const TestInfo &test) {
+    auto start = std::chrono::steady_clock::now();
+    
+    TestResult result = {test.name, false, "", 0};
+    
+    try {
+        result.message = runTest(suite, test);
+        result.passed  = result.message.empty();
+    } catch (const std::exception &e) {
+        result.message = e.what();
+    }
+    
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    return result;
+}
+
+bool RunTests(const Config &suite, std::ostream &out, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    
+    ThreadPool pool(threads);
+    
+    std::vector<std::future<TestResult>> results;
+    
+    for (auto &test : suite.getTests())
+        results.push_back(pool.submit([&suite, &test] {
+            return RunTest(suite, test);
+        }));
+    
+    std::size_t failed = 0;
+    
+    for (auto &future : results) {
+        auto result = future.get();
+        
+        if (result.passed)
+            out << "ok   " << result.name << '\n';
+        else {
+            out << "FAIL " << result.name << ": " << result.message << '\n';
+            failed++;
+        }
+    }
+    
+    out <<
+    results.size() - failed << " passed, " << failed << " failed in " <<
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+    
+    return !failed;
+}
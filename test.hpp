@@ -0,0 +1,30 @@
+#ifndef TEST_HPP
+#define TEST_HPP
+
+
+#include <string>
+#include <ostream>
+#include "config.hpp"
+
+
+/*
+ * Scenario tests.
+ *
+ * Each test of a suite (see TestInfo) runs as its own headless, seeded game,
+ * with one league per script, so tests are independent and run in parallel.
+ */
+
+struct TestResult {
+    std::string name;
+    bool passed;
+    std::string message;
+    double seconds;
+};
+
+TestResult RunTest(const Config &suite, const TestInfo &test);
+
+// Prints one line per test in suite order; returns true if all passed.
+bool RunTests(const Config &suite, std::ostream &out, unsigned threads = 0);
+
+
+#endif
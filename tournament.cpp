@@ -0,0 +1,448 @@
+#include "tournament.hpp"
+#include <vector>
+#include <string>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <exception>
+#include "game.hpp"
+#include "pool.hpp"
+#include "results.hpp"
+
+
+namespace {
+
+struct Player {
+    std::string name;
+    
+    double rating = 1500, deviation = 350;
+    
+    unsigned wins = 0, draws = 0, losses = 0;
+};
+
+// Counted from the point of view of 'a'.
+struct Pairing {
+    std::size_t a, b;
+    
+    unsigned wins = 0, draws = 0, losses = 0;
+    
+    int decision = 0;  // 1 if a is stronger, -1 if b is
+    
+    unsigned games() const noexcept {return wins + draws + losses;}
+};
+
+struct Group {
+    std::vector<std::size_t> players, pairings;
+    
+    int scheduled = 0, played = 0;
+};
+
+struct Job {
+    std::size_t group;
+    std::uint64_t seed;
+};
+
+double expectedScore(double rating, double opponent) {
+    return 1 / (1 + std::pow(10, (opponent - rating) / 400));
+}
+
+/*
+ * Glicko-1 with every game as its own rating period. The deviation is kept
+ * from collapsing so that late results still move the rating.
+ */
+
+void updateGlicko(Player &player, const Player &opponent, double score) {
+    static const double pi = std::acos(-1.0);
+    static const double q  = std::log(10.0) / 400;
+    static const double minDeviation = 30;
+    
+    double g = 1 / std::sqrt(1 + 3 * q * q * opponent.deviation * opponent.deviation / (pi * pi));
+    double e = 1 / (1 + std::pow(10, -g * (player.rating - opponent.rating) / 400));
+    
+    double d2       = 1 / (q * q * g * g * e * (1 - e));
+    double variance = 1 / (1 / (player.deviation * player.deviation) + 1 / d2);
+    
+    player.rating   += q * variance * g * (score - e);
+    player.deviation = std::max(std::sqrt(variance), minDeviation);
+}
+
+/*
+ * The log-likelihood ratio of 'a is elo points stronger than b' against
+ * 'b is elo points stronger than a' in Wald's test, a draw counting as half
+ * a win and half a loss. Only the difference of wins and losses matters.
+ */
+
+double sprtLLR(const Pairing &pairing, double elo) {
+    double s = expectedScore(elo, 0);
+    
+    return (static_cast<double>(pairing.wins) - pairing.losses) * std::log(s / (1 - s));
+}
+
+std::string resolve(const std::string &directory, const std::string &path) {
+    if (!path.empty() && path.front() == '/')
+        return path;
+    
+    return directory + '/' + path;
+}
+
+class Tournament {
+private:
+    const Config &config;
+    const TournamentInfo &info;
+    
+    std::ostream &out;
+    
+    std::vector<Player>  players;
+    std::vector<Pairing> pairings;
+    std::vector<Group>   groups;
+    
+    std::mutex mutex;
+    
+    std::exception_ptr error;
+    
+    unsigned played = 0;
+    
+    void addGroups(std::vector<std::size_t> &members, std::size_t first);
+    
+    bool isDecided(const Group &group) const;
+    
+    void score(Pairing &pairing, double score);
+    
+public:
+    Tournament(const Config &config, std::ostream &out);
+    
+    // Picks the undecided group that has had the fewest games so far.
+    bool next(Job &job);
+    
+    void report(const Job &job, const std::vector<std::uint64_t> &biomass);
+    void fail(std::exception_ptr error);
+    
+    // The leagues of a game in the order of its results.
+    std::vector<std::string> getNames(const Job &job) const;
+    Json::Value gameRoot(const Job &job) const;
+    
+    void printStandings(double seconds, unsigned threads) const;
+    
+    void rethrow() const {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+Tournament::Tournament(const Config &config, std::ostream &out)
+: config(config), info(config.getTournament()), out(out) {
+    for (auto &kv : config.getLeagueInfo()) {
+        Player player;
+        player.name = kv.first;
+        
+        players.push_back(player);
+    }
+    
+    std::sort(players.begin(), players.end(), [](const Player &a, const Player &b) {
+        return a.name < b.name;
+    });
+    
+    for (std::size_t a = 0; a < players.size(); a++)
+        for (std::size_t b = a + 1; b < players.size(); b++) {
+            Pairing pairing;
+            pairing.a = a;
+            pairing.b = b;
+            
+            pairings.push_back(pairing);
+        }
+    
+    std::vector<std::size_t> members;
+    addGroups(members, 0);
+}
+
+void Tournament::addGroups(std::vector<std::size_t> &members, std::size_t first) {
+    if (members.size() == static_cast<std::size_t>(info.groupSize)) {
+        Group group;
+        group.players = members;
+        
+        for (std::size_t i = 0; i < members.size(); i++)
+            for (std::size_t j = i + 1; j < members.size(); j++) {
+                auto pairing = std::find_if(pairings.begin(), pairings.end(), [&](const Pairing &p) {
+                    return p.a == members[i] && p.b == members[j];
+                });
+                
+                group.pairings.push_back(pairing - pairings.begin());
+            }
+        
+        groups.push_back(group);
+        
+        return;
+    }
+    
+    for (std::size_t i = first; i < players.size(); i++) {
+        members.push_back(i);
+        addGroups(members, i + 1);
+        members.pop_back();
+    }
+}
+
+bool Tournament::isDecided(const Group &group) const {
+    if (info.sprtElo <= 0)
+        return false;
+    
+    for (auto i : group.pairings)
+        if (!pairings[i].decision)
+            return false;
+    
+    return true;
+}
+
+bool Tournament::next(Job &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (error)
+        return false;
+    
+    Group *best = nullptr;
+    
+    for (auto &group : groups)
+        if (group.scheduled < info.games && !isDecided(group) && (!best || group.scheduled < best->scheduled))
+            best = &group;
+    
+    if (!best)
+        return false;
+    
+    job.group = best - groups.data();
+    
+    // Seeds of neighbouring games should be unrelated, so they go through SplitMix64's finalizer.
+    std::uint64_t z = config.getSeed() + job.group * 0x9E3779B97F4A7C15ull + best->scheduled++ * 0xD1B54A32D192ED03ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    
+    job.seed = z ? z : 1;
+    
+    return true;
+}
+
+void Tournament::score(Pairing &pairing, double score) {
+    auto &a = players[pairing.a];
+    auto &b = players[pairing.b];
+    
+    if (score > 0.5) {
+        pairing.wins++;
+        a.wins++;
+        b.losses++;
+    } else if (score < 0.5) {
+        pairing.losses++;
+        a.losses++;
+        b.wins++;
+    } else {
+        pairing.draws++;
+        a.draws++;
+        b.draws++;
+    }
+    
+    if (info.rating == TournamentInfo::Rating::Elo) {
+        double delta = info.k * (score - expectedScore(a.rating, b.rating));
+        
+        a.rating += delta;
+        b.rating -= delta;
+    } else {
+        auto before = a;
+        
+        updateGlicko(a, b, score);
+        updateGlicko(b, before, 1 - score);
+    }
+    
+    if (info.sprtElo <= 0 || pairing.decision)
+        return;
+    
+    double llr = sprtLLR(pairing, info.sprtElo);
+    
+    if (llr >= std::log((1 - info.sprtBeta) / info.sprtAlpha))
+        pairing.decision = 1;
+    else if (llr <= std::log(info.sprtBeta / (1 - info.sprtAlpha)))
+        pairing.decision = -1;
+    else
+        return;
+    
+    auto &stronger = pairing.decision > 0 ? a : b;
+    auto &weaker   = pairing.decision > 0 ? b : a;
+    
+    auto wins   = pairing.decision > 0 ? pairing.wins   : pairing.losses;
+    auto losses = pairing.decision > 0 ? pairing.losses : pairing.wins;
+    
+    out <<
+    stronger.name << " > " << weaker.name << " after " << pairing.games() << " games "
+    "(+" << wins << " =" << pairing.draws << " -" << losses << "), "
+    "LLR " << std::fixed << std::setprecision(2) << std::fabs(llr) << std::defaultfloat << '\n';
+}
+
+void Tournament::report(const Job &job, const std::vector<std::uint64_t> &biomass) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto &group = groups[job.group];
+    
+    group.played++;
+    played++;
+    
+    std::size_t k = 0;
+    
+    for (std::size_t i = 0; i < group.players.size(); i++)
+        for (std::size_t j = i + 1; j < group.players.size(); j++, k++)
+            score(pairings[group.pairings[k]], biomass[i] > biomass[j] ? 1 : biomass[i] < biomass[j] ? 0 : 0.5);
+}
+
+void Tournament::fail(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    if (!this->error)
+        this->error = error;
+}
+
+std::vector<std::string> Tournament::getNames(const Job &job) const {
+    std::vector<std::string> names;
+    
+    for (auto i : groups[job.group].players)
+        names.push_back(players[i].name);
+    
+    return names;
+}
+
+Json::Value Tournament::gameRoot(const Job &job) const {
+    // Everything but the leagues, the seed and the window is played as the tournament config says.
+    auto root = config.getRoot();
+    root.removeMember("tournament");
+    root.removeMember("leagues");
+    
+    root["headless"] = true;
+    root["seed"]     = Json::UInt64(job.seed);
+    
+    for (auto i : groups[job.group].players) {
+        auto &name = players[i].name;
+        auto &info = config.getLeagueInfo().at(name);
+        
+        auto &league = root["leagues"][name];
+        league["directory"] = resolve(config.getDirectory(), info.directory);
+        league["startKind"] = info.startKind;
+        
+        // Without sprites, which headless games never draw.
+        for (auto &kv : info.unitKinds)
+            league["unitKinds"][kv.first]["exec"] = kv.second.exec;
+    }
+    
+    return root;
+}
+
+void Tournament::printStandings(double seconds, unsigned threads) const {
+    bool glicko = info.rating == TournamentInfo::Rating::Glicko;
+    
+    auto standings = players;
+    
+    std::stable_sort(standings.begin(), standings.end(), [](const Player &a, const Player &b) {
+        return a.rating > b.rating;
+    });
+    
+    std::size_t width = 6;
+    for (auto &player : players)
+        width = std::max(width, player.name.size());
+    
+    out << '\n' << std::left << std::setw(6) << "Rank" << std::setw(width + 2) << "League" << std::right <<
+    std::setw(8) << "Rating" << (glicko ? "      RD" : "") <<
+    std::setw(7) << "Games" << std::setw(6) << "+" << std::setw(6) << "=" << std::setw(6) << "-" << '\n';
+    
+    out << std::fixed << std::setprecision(1);
+    
+    for (std::size_t i = 0; i < standings.size(); i++) {
+        auto &player = standings[i];
+        
+        out << std::left << std::setw(6) << i + 1 << std::setw(width + 2) << player.name << std::right <<
+        std::setw(8) << player.rating;
+        
+        if (glicko)
+            out << std::setw(8) << player.deviation;
+        
+        out <<
+        std::setw(7) << player.wins + player.draws + player.losses <<
+        std::setw(6) << player.wins << std::setw(6) << player.draws << std::setw(6) << player.losses << '\n';
+    }
+    
+    std::size_t decided = std::count_if(pairings.begin(), pairings.end(), [](const Pairing &p) {
+        return p.decision != 0;
+    });
+    
+    out << '\n' <<
+    played << " of at most " << groups.size() * info.games << " games played in " << seconds << " s "
+    "on " << threads << " threads, " << decided << " of " << pairings.size() << " pairings decided.\n" <<
+    std::defaultfloat;
+}
+
+std::vector<std::uint64_t> playGame(const Json::Value &root, const std::vector<std::string> &names, ResultWriter *results) {
+    auto start = std::chrono::steady_clock::now();
+    
+    Config config(root);
+    Game game(config);
+    
+    // As 'deathgame -headless -seed' and the server play it, so that a game can be replayed.
+    SeedRandom(game.getMoveSeed());
+    
+    int maxMoves = config.getMaxMoves();
+    
+    game.step(maxMoves - game.getMove());
+    
+    if (results)
+        results->write(game, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    
+    std::vector<std::uint64_t> biomass;
+    
+    for (auto &name : names)
+        biomass.push_back(game.findLeague(name)->getTotalBiomass());
+    
+    // A stalemate without a dominating league is a draw between everyone.
+    if ((game.getEnding() == Game::Ending::Cycle || game.getEnding() == Game::Ending::SteadyState) && game.getWinner().empty())
+        std::fill(biomass.begin(), biomass.end(), 0);
+    
+    return biomass;
+}
+
+}
+
+void RunTournament(const Config &config, std::ostream &out, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    
+    Tournament tournament(config, out);
+    
+    std::unique_ptr<ResultWriter> results;
+    
+    if (!config.getResultsPath().empty())
+        results.reset(new ResultWriter(config.getResultsPath(), ResultWriter::parseFormat(config.getResultsFormat())));
+    
+    ThreadPool pool(threads);
+    
+    std::vector<std::future<void>> workers;
+    
+    for (std::size_t i = 0; i < pool.size(); i++)
+        workers.push_back(pool.submit([&tournament, &results] {
+            Job job;
+            
+            while (tournament.next(job)) {
+                std::vector<std::uint64_t> biomass;
+                
+                try {
+                    biomass = playGame(tournament.gameRoot(job), tournament.getNames(job), results.get());
+                } catch (...) {
+                    tournament.fail(std::current_exception());
+                    return;
+                }
+                
+                tournament.report(job, biomass);
+            }
+        }));
+    
+    for (auto &worker : workers)
+        worker.get();
+    
+    tournament.rethrow();
+    
+    tournament.printStandings(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), pool.size());
+}
@@ -0,0 +1,23 @@
+#ifndef TOURNAMENT_HPP
+#define TOURNAMENT_HPP
+
+
+#include <ostream>
+#include "config.hpp"
+
+
+/*
+ * Tournaments.
+ *
+ * The leagues of a config with 'tournament' (see TournamentInfo) play each
+ * other in headless, seeded games on a thread pool. Every game is scored
+ * pairwise by the biomass each league has at the end, ratings are updated
+ * as results come in, and a pairing stops getting games once the
+ * sequential probability ratio test has picked the stronger league.
+ */
+
+// Prints decisions as they are made and the standings at the end; rethrows the first error of a game.
+void RunTournament(const Config &config, std::ostream &out, unsigned threads = 0);
+
+
+#endif
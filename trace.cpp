@@ -0,0 +1,195 @@
+#include "trace.hpp"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+
+
+std::atomic<bool> TraceActive{false};
+
+namespace {
+
+struct Event {
+    const char  *name;
+    std::int64_t start, value;  // value is the duration of a span
+    unsigned     series;
+    char         phase;
+};
+
+struct Buffer {
+    std::vector<Event> events;
+    
+    // Published with release, so that TraceStop() reads only complete events.
+    std::atomic<std::size_t> size{0};
+    std::size_t dropped = 0;
+    
+    const char *threadName = nullptr;
+    unsigned    tid;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    std::map<unsigned, std::string> series;
+    
+    std::string  path;
+    std::size_t  capacity = 0;
+    std::int64_t start = 0;
+};
+
+Registry registry;
+
+thread_local std::shared_ptr<Buffer> localBuffer;
+
+Buffer &getLocalBuffer() {
+    if (!localBuffer) {
+        auto buffer = std::make_shared<Buffer>();
+        
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        
+        buffer->events.resize(registry.capacity);
+        buffer->tid = static_cast<unsigned>(registry.buffers.size()) + 1;
+        
+        registry.buffers.push_back(buffer);
+        localBuffer = buffer;
+    }
+    
+    return *localBuffer;
+}
+
+void append(const Event &event) {
+    auto &buffer = getLocalBuffer();
+    auto size = buffer.size.load(std::memory_order_relaxed);
+    
+    if (size == buffer.events.size()) {
+        buffer.dropped++;
+        return;
+    }
+    
+    buffer.events[size] = event;
+    buffer.size.store(size + 1, std::memory_order_release);
+}
+
+void writeString(std::FILE *file, const char *s) {
+    std::fputc('"', file);
+    
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            std::fputc('\\', file);
+        
+        if (static_cast<unsigned char>(*s) >= 0x20)
+            std::fputc(*s, file);
+    }
+    
+    std::fputc('"', file);
+}
+
+}
+
+void TraceComplete(const char *name, std::int64_t start, std::int64_t end) {
+    append({name, start, end - start, 0, 'X'});
+}
+
+void TraceCounter(const char *name, unsigned series, std::int64_t value) {
+    if (TraceActive.load(std::memory_order_relaxed))
+        append({name, TraceNow(), value, series, 'C'});
+}
+
+void TraceSeriesName(unsigned series, const std::string &name) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.series[series] = name;
+}
+
+void TraceThreadName(const char *name) {
+    if (TraceActive.load(std::memory_order_relaxed))
+        getLocalBuffer().threadName = name;
+}
+
+void TraceStart(const std::string &path, std::size_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        
+        registry.path     = path;
+        registry.capacity = capacity;
+        registry.start    = TraceNow();
+    }
+    
+    TraceActive = true;
+    TraceThreadName("main");
+}
+
+void TraceStop() {
+    if (!TraceActive.exchange(false))
+        return;
+    
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    
+    std::FILE *file = registry.path == "-" ? stdout : std::fopen(registry.path.c_str(), "w");
+    
+    if (!file) {
+        std::cerr << "Failed to write the trace to '" << registry.path << "'.\n";
+        return;
+    }
+    
+    std::vector<char> buffer(1 << 16);
+    if (file != stdout)
+        std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    
+    auto pid = static_cast<long>(getpid());
+    bool first = true;
+    
+    auto separate = [&] {
+        std::fputs(first ? "\n" : ",\n", file);
+        first = false;
+    };
+    
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+    
+    std::size_t dropped = 0;
+    
+    for (auto &b : registry.buffers) {
+        if (b->threadName) {
+            separate();
+            std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%u,\"args\":{\"name\":", pid, b->tid);
+            writeString(file, b->threadName);
+            std::fputs("}}", file);
+        }
+        
+        auto size = b->size.load(std::memory_order_acquire);
+        
+        for (std::size_t i = 0; i < size; i++) {
+            auto &e = b->events[i];
+            double ts = (e.start - registry.start) / 1e3;
+            
+            separate();
+            std::fputs("{\"name\":", file);
+            writeString(file, e.name);
+            
+            if (e.phase == 'X') {
+                std::fprintf(file, ",\"ph\":\"X\",\"pid\":%ld,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", pid, b->tid, ts, e.value / 1e3);
+            } else {
+                std::fprintf(file, ",\"ph\":\"C\",\"pid\":%ld,\"tid\":%u,\"ts\":%.3f,\"args\":{", pid, b->tid, ts);
+                
+                auto name = registry.series.find(e.series);
+                writeString(file, name != registry.series.end() ? name->second.c_str() : std::to_string(e.series).c_str());
+                
+                std::fprintf(file, ":%lld}}", static_cast<long long>(e.value));
+            }
+        }
+        
+        dropped += b->dropped;
+    }
+    
+    std::fputs("\n]}\n", file);
+    
+    if (file != stdout)
+        std::fclose(file);
+    else
+        std::fflush(file);
+    
+    if (dropped)
+        std::cerr << "Trace buffers were full, " << dropped << " events were lost.\n";
+}
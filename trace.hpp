@@ -0,0 +1,64 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+
+/*
+ * Timeline tracing.
+ *
+ * Spans and counters go into a buffer allocated once per thread, which is
+ * only appended to while tracing, and are written as Chrome trace_event
+ * JSON (chrome://tracing, Perfetto) by TraceStop(). A thread whose buffer
+ * fills up stops recording and the lost events are reported. Names must
+ * be string literals or otherwise outlive tracing.
+ */
+
+extern std::atomic<bool> TraceActive;
+
+// Nanoseconds on the trace clock.
+static inline std::int64_t TraceNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void TraceComplete(const char *name, std::int64_t start, std::int64_t end);
+
+// One series of a counter track, e.g. the units of a league.
+void TraceCounter(const char *name, unsigned series, std::int64_t value);
+
+// Labels a counter series and the calling thread.
+void TraceSeriesName(unsigned series, const std::string &name);
+void TraceThreadName(const char *name);
+
+class TraceSpan {
+private:
+    const char  *name;
+    std::int64_t start;
+    
+public:
+    explicit TraceSpan(const char *name)
+    : name(TraceActive.load(std::memory_order_relaxed) ? name : nullptr), start(this->name ? TraceNow() : 0) {}
+    
+    ~TraceSpan() {
+        if (name)
+            TraceComplete(name, start, TraceNow());
+    }
+    
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+// 'capacity' is in events per thread.
+void TraceStart(const std::string &path, std::size_t capacity = 1 << 20);
+
+// Writes the trace; events recorded after this are lost.
+void TraceStop();
+
+
+#endif
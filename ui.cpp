@@ -1,6 +1,10 @@
 #include "ui.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 #include <chrono>
 #include <algorithm>
+#include <iostream>
+#include <cmath>
 #include <SDL.h>
 #include <SDL_image.h>
 
@@ -16,11 +20,11 @@ enum {
 
 static vector<UIDisplayInfo> displayInfo;
 
-void UIInit() {
-    if (SDL_Init(SDL_INIT_VIDEO))
+void UIInit(bool video) {
+    if (SDL_Init(video ? SDL_INIT_VIDEO : 0))
         throw UIDisplayError();
     
-    int displayNumber = SDL_GetNumVideoDisplays();
+    int displayNumber = video ? SDL_GetNumVideoDisplays() : 0;
     
     displayInfo.resize(displayNumber);
     
@@ -54,33 +58,148 @@ void UIQuit() {
     displayInfo.clear();
 }
 
-Sprite::Sprite(const char *path) : sourceType(SOURCE_IMAGE) {
-    if (!(surface = IMG_Load(path)))
+Sprite::Sprite(const char *path) : sourceType(SOURCE_IMAGE), image(std::make_shared<Image>()) {
+    // Missing files are still reported up front.
+    FileOpenIn(path, true);
+    
+    image->path = path;
+}
+
+SDL_Surface *Sprite::Image::decode() {
+    if (!surface) {
+        TraceSpan span("decodeImage");
+        
+        if (!(surface = ImplicitPtr<SDL_Surface>(IMG_Load(path.c_str()), SDL_FreeSurface)))
+            throw UIDisplayError();
+    }
+    
+    return surface;
+}
+
+SDL_Texture *Sprite::Image::getTexture(SDL_Renderer *renderer, int w, int h) {
+    auto &slot = textures[(w & 1) * 2 + (h & 1)];
+    
+    if (!slot.texture || w != slot.width || h != slot.height) {
+        TraceSpan span("createTexture");
+        
+        auto source = decode();
+        
+        ImplicitPtr<SDL_Surface> scaled(
+            SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32),
+            SDL_FreeSurface
+        );
+        
+        if (!scaled ||
+            SDL_SetSurfaceBlendMode(source, SDL_BLENDMODE_NONE) ||
+            SDL_BlitScaled(source, nullptr, scaled, nullptr))
+            throw UIDisplayError();
+        
+        if (!(slot.texture = ImplicitPtr<SDL_Texture>(SDL_CreateTextureFromSurface(renderer, scaled), SDL_DestroyTexture)))
+            throw UIDisplayError();
+        
+        slot.width  = w;
+        slot.height = h;
+    }
+    
+    return slot.texture;
+}
+
+// Nearest neighbour sampling with alpha blending over the background,
+// which is what SDL_RenderCopy does with the default blend mode.
+static void rasterizeSurface(SDL_Surface *surface, std::vector<std::uint8_t> &rgb, int w, int h) {
+    ImplicitPtr<SDL_Surface> rgba(
+        SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0),
+        SDL_FreeSurface
+    );
+    
+    if (!rgba || SDL_LockSurface(rgba))
         throw UIDisplayError();
+    
+    auto pixels = static_cast<const std::uint8_t *>(rgba->pixels);
+    
+    for (int y = 0; y < h; y++) {
+        auto row = pixels + (y * rgba->h / h) * rgba->pitch;
+        
+        for (int x = 0; x < w; x++) {
+            auto src = row + (x * rgba->w / w) * 4;
+            auto dst = &rgb[(y * w + x) * 3];
+            
+            int a = src[3];
+            
+            dst[0] = (src[0] * a + BG_RED   * (255 - a)) / 255;
+            dst[1] = (src[1] * a + BG_GREEN * (255 - a)) / 255;
+            dst[2] = (src[2] * a + BG_BLUE  * (255 - a)) / 255;
+        }
+    }
+    
+    SDL_UnlockSurface(rgba);
+}
+
+SDL_Color Sprite::getAverageColor() const {
+    if (sourceType == SOURCE_RGB)
+        return average;
+    
+    std::lock_guard<std::mutex> lock(image->mutex);
+    
+    if (!image->averaged) {
+        std::vector<std::uint8_t> rgb(8 * 8 * 3);
+        rasterizeSurface(image->decode(), rgb, 8, 8);
+        
+        unsigned sum[3] = {0, 0, 0};
+        for (std::size_t i = 0; i < rgb.size(); i++)
+            sum[i % 3] += rgb[i];
+        
+        image->average = {
+            static_cast<std::uint8_t>(sum[0] / 64),
+            static_cast<std::uint8_t>(sum[1] / 64),
+            static_cast<std::uint8_t>(sum[2] / 64),
+            SDL_ALPHA_OPAQUE
+        };
+        
+        image->averaged = true;
+    }
+    
+    return image->average;
 }
 
-void Sprite::render(SDL_Renderer *renderer, SDL_Rect *rect) {
+void Sprite::render(SDL_Renderer *renderer, const SDL_Rect *rects, int count) {
     switch (sourceType) {
         case SOURCE_RGB:
             if (SDL_SetRenderDrawColor(renderer, red, green, blue, SDL_ALPHA_OPAQUE))
                 throw UIDisplayError();
             
-            if (SDL_RenderFillRect(renderer, rect))
+            if (SDL_RenderFillRects(renderer, rects, count))
                 throw UIDisplayError();
             
             break;
-        case SOURCE_IMAGE:
-            if (!texture) {
-                if (!(texture = ImplicitPtr<SDL_Texture>(SDL_CreateTextureFromSurface(renderer, surface), SDL_DestroyTexture)))
-                    throw UIDisplayError();
-                
-                // SDL_FreeSurface may accept NULL, so this should be safe.
-                surface.reset((SDL_Surface *)nullptr, SDL_FreeSurface);
-            }
+        case SOURCE_IMAGE: {
+            std::lock_guard<std::mutex> lock(image->mutex);
             
-            SDL_RenderCopy(renderer, texture, nullptr, rect);
+            for (int i = 0; i < count; i++)
+                SDL_RenderCopy(renderer, image->getTexture(renderer, rects[i].w, rects[i].h), nullptr, &rects[i]);
             
             break;
+        }
+    }
+}
+
+void Sprite::rasterize(std::vector<std::uint8_t> &rgb, int w, int h) const {
+    rgb.resize(w * h * 3);
+    
+    switch (sourceType) {
+        case SOURCE_RGB:
+            for (std::size_t i = 0; i < rgb.size(); i += 3) {
+                rgb[i]     = red;
+                rgb[i + 1] = green;
+                rgb[i + 2] = blue;
+            }
+            
+            break;
+        case SOURCE_IMAGE: {
+            std::lock_guard<std::mutex> lock(image->mutex);
+            rasterizeSurface(image->decode(), rgb, w, h);
+            break;
+        }
     }
 }
 
@@ -101,7 +220,47 @@ UIDisplay::UIDisplay(
     int width, int height,
     int columnNumber, int rowNumber,
     bool fullscreen,
-    const char *title) {
+    const char *title,
+    Output output) : output(output), title(title) {
+    this->columnNumber = columnNumber;
+    this->rowNumber = rowNumber;
+    
+    screen.resize(columnNumber * rowNumber, 0);
+    cells = screen.data();
+    
+    // 0 is always the background sprite.
+    registerSprite(Sprite(BG_RED, BG_GREEN, BG_BLUE));
+    
+    if (output != Output::Window) {
+        this->x = this->y = 0;
+        this->width  = width;
+        this->height = height;
+        
+        spriteWidth  = width  / columnNumber;
+        spriteHeight = height / rowNumber;
+        
+        // No window: without output only the board state and the sprites are kept, e.g. for capturing.
+        if (output == Output::None)
+            return;
+        
+        target = ImplicitPtr<SDL_Surface>(
+            SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888),
+            SDL_FreeSurface
+        );
+        
+        if (!target)
+            throw UIDisplayError();
+        
+        renderer = ImplicitPtr<SDL_Renderer>(SDL_CreateSoftwareRenderer(target), SDL_DestroyRenderer);
+        
+        if (!renderer)
+            throw UIDisplayError();
+        
+        fitView();
+        
+        return;
+    }
+    
     if (x < 0)
         x = SDL_WINDOWPOS_CENTERED_DISPLAY(display);
     else
@@ -152,68 +311,472 @@ UIDisplay::UIDisplay(
     
     SDL_RenderPresent(renderer);
     
-    this->columnNumber = columnNumber;
-    this->rowNumber = rowNumber;
+    if ((wakeEvent = SDL_RegisterEvents(1)) == (Uint32)-1)
+        throw UIDisplayError();
     
     spriteWidth = width / columnNumber;
     spriteHeight = height / rowNumber;
     
-    screen.resize(columnNumber * rowNumber, 0);
-    
-    // 0 is always the background sprite.
-    registerSprite(Sprite(BG_RED, BG_GREEN, BG_BLUE));
+    fitView();
 }
 
-SpriteID UIDisplay::registerSprite(const Sprite &sprite) {
+SpriteID UIDisplay::registerSprite(const Sprite &sprite, unsigned group) {
     sprites.push_back(sprite);
+    spriteGroups.push_back(group);
+    
+    groupsStale = true;
+    
     return (SpriteID)(sprites.size() - 1);
 }
 
 void UIDisplay::blitSprite(int x, int y, SpriteID id) {
     screen[y * columnNumber + x] = id;
+    unpublished = true;
+}
+
+void UIDisplay::publish() {
+    if (output != Output::Window || (!unpublished && cells == screen.data()))
+        return;
+    
+    unpublished = false;
+    
+    publishedAt.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    
+    // One wake-up in flight is enough, however often the simulation publishes.
+    if (!wakePending.exchange(true)) {
+        SDL_Event evt = {};
+        evt.type = wakeEvent;
+        
+        if (SDL_PushEvent(&evt) <= 0)
+            wakePending = false;
+    }
+}
+
+void UIDisplay::fitView() {
+    zoom = std::min(static_cast<double>(width) / columnNumber, static_cast<double>(height) / rowNumber);
+    
+    // Centre the board along the axis it does not fill.
+    viewX = (columnNumber - width  / zoom) / 2;
+    viewY = (rowNumber    - height / zoom) / 2;
+}
+
+void UIDisplay::zoomAt(double factor, int px, int py) {
+    const double fit = std::min(static_cast<double>(width) / columnNumber, static_cast<double>(height) / rowNumber);
+    
+    double newZoom = std::min(std::max(zoom * factor, fit / 2), 64.0);
+    
+    // Keep the cell under (px, py) where it is.
+    viewX += px / zoom - px / newZoom;
+    viewY += py / zoom - py / newZoom;
+    
+    zoom = newZoom;
+    
+    clampView();
+}
+
+void UIDisplay::pan(double dx, double dy) {
+    viewX += dx / zoom;
+    viewY += dy / zoom;
+    
+    clampView();
+}
+
+void UIDisplay::clampView() {
+    // At least half of the window stays over the board.
+    const double halfWidth  = width  / zoom / 2;
+    const double halfHeight = height / zoom / 2;
+    
+    viewX = std::min(std::max(viewX, -halfWidth),  columnNumber - halfWidth);
+    viewY = std::min(std::max(viewY, -halfHeight), rowNumber    - halfHeight);
+}
+
+bool UIDisplay::handleViewEvent(const SDL_Event &evt) {
+    switch (evt.type) {
+        case SDL_MOUSEWHEEL:
+            zoomAt(std::pow(1.25, evt.wheel.y), mouseX, mouseY);
+            return true;
+        case SDL_MOUSEBUTTONDOWN:
+            if (evt.button.button == SDL_BUTTON_LEFT)
+                dragging = true;
+            
+            return false;
+        case SDL_MOUSEBUTTONUP:
+            if (evt.button.button == SDL_BUTTON_LEFT)
+                dragging = false;
+            
+            return false;
+        case SDL_MOUSEMOTION:
+            mouseX = evt.motion.x;
+            mouseY = evt.motion.y;
+            
+            if (!dragging)
+                return false;
+            
+            pan(-evt.motion.xrel, -evt.motion.yrel);
+            return true;
+        case SDL_KEYDOWN:
+            switch (evt.key.keysym.sym) {
+                case SDLK_LEFT:
+                    pan(-width / 10.0, 0);
+                    return true;
+                case SDLK_RIGHT:
+                    pan(width / 10.0, 0);
+                    return true;
+                case SDLK_UP:
+                    pan(0, -height / 10.0);
+                    return true;
+                case SDLK_DOWN:
+                    pan(0, height / 10.0);
+                    return true;
+                case SDLK_EQUALS:
+                case SDLK_PLUS:
+                    zoomAt(1.25, width / 2, height / 2);
+                    return true;
+                case SDLK_MINUS:
+                    zoomAt(0.8, width / 2, height / 2);
+                    return true;
+                case SDLK_0:
+                    fitView();
+                    return true;
+            }
+            
+            return false;
+    }
+    
+    return false;
+}
+
+void UIDisplay::renderCells() {
+    const int c0 = std::max(0, static_cast<int>(std::floor(viewX)));
+    const int r0 = std::max(0, static_cast<int>(std::floor(viewY)));
+    const int c1 = std::min(columnNumber, static_cast<int>(std::ceil(viewX + width  / zoom)));
+    const int r1 = std::min(rowNumber,    static_cast<int>(std::ceil(viewY + height / zoom)));
+    
+    if (c0 >= c1 || r0 >= r1)
+        return;
+    
+    // Cell edges in pixels, so that neighbouring cells neither overlap nor leave gaps.
+    edges.resize(c1 - c0 + 1);
+    for (int c = c0; c <= c1; c++)
+        edges[c - c0] = static_cast<int>(std::floor((c - viewX) * zoom));
+    
+    batches.resize(sprites.size());
+    
+    for (int r = r0; r < r1; r++) {
+        const int top    = static_cast<int>(std::floor((r     - viewY) * zoom));
+        const int bottom = static_cast<int>(std::floor((r + 1 - viewY) * zoom));
+        
+        auto row = &cells[r * columnNumber];
+        
+        for (int c = c0; c < c1; c++) {
+            // The background is already there after clearing.
+            if (auto id = row[c]) {
+                const int left = edges[c - c0];
+                batches[id].push_back({left, top, edges[c - c0 + 1] - left, bottom - top});
+            }
+        }
+    }
+    
+    for (SpriteID id = 1; id < batches.size(); id++) {
+        if (batches[id].empty())
+            continue;
+        
+        sprites[id].render(renderer, batches[id].data(), static_cast<int>(batches[id].size()));
+        batches[id].clear();
+    }
+}
+
+void UIDisplay::updateGroups() {
+    groups.assign(*std::max_element(spriteGroups.begin(), spriteGroups.end()) + 1, SpriteGroup());
+    
+    // The background is not part of any group.
+    for (SpriteID id = 1; id < sprites.size(); id++) {
+        auto color = sprites[id].getAverageColor();
+        auto &group = groups[spriteGroups[id]];
+        
+        group.red   += color.r;
+        group.green += color.g;
+        group.blue  += color.b;
+        group.sprites++;
+    }
+    
+    groupsStale = false;
+}
+
+void UIDisplay::renderDensity() {
+    if (groupsStale)
+        updateGroups();
+    
+    // The part of the window covered by the board.
+    const int x0 = std::max(0,      static_cast<int>(std::floor(-viewX * zoom)));
+    const int y0 = std::max(0,      static_cast<int>(std::floor(-viewY * zoom)));
+    const int x1 = std::min(width,  static_cast<int>(std::ceil((columnNumber - viewX) * zoom)));
+    const int y1 = std::min(height, static_cast<int>(std::ceil((rowNumber    - viewY) * zoom)));
+    
+    const int w = x1 - x0, h = y1 - y0;
+    
+    if (w <= 0 || h <= 0)
+        return;
+    
+    if (!densityTexture || w != densityWidth || h != densityHeight) {
+        densityTexture = ImplicitPtr<SDL_Texture>(
+            SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h),
+            SDL_DestroyTexture
+        );
+        
+        if (!densityTexture)
+            throw UIDisplayError();
+        
+        densityWidth  = w;
+        densityHeight = h;
+        
+        densityPixels.resize(w * h);
+    }
+    
+    // Block boundaries in cells for every output column and row.
+    auto bounds = [this](std::vector<int> &out, int p0, int n, double view, int cells) {
+        out.resize(n + 1);
+        
+        for (int i = 0; i <= n; i++)
+            out[i] = std::min(std::max(static_cast<int>(std::floor(view + (p0 + i) / zoom)), 0), cells);
+        
+        // Every pixel gets at least one cell.
+        for (int i = 0; i < n; i++)
+            if (out[i + 1] <= out[i])
+                out[i + 1] = std::min(out[i] + 1, cells);
+    };
+    
+    bounds(densityColumns, x0, w, viewX, columnNumber);
+    bounds(densityRows,    y0, h, viewY, rowNumber);
+    
+    if (!pool)
+        pool.reset(new ThreadPool());
+    
+    pool->parallelFor(h, [this, w](std::size_t begin, std::size_t end) {
+        std::vector<unsigned> counts(groups.size(), 0);
+        std::vector<unsigned> touched;
+        
+        for (std::size_t py = begin; py < end; py++) {
+            const int r0 = densityRows[py], r1 = densityRows[py + 1];
+            
+            for (int px = 0; px < w; px++) {
+                const int c0 = densityColumns[px], c1 = densityColumns[px + 1];
+                
+                unsigned occupied = 0;
+                
+                for (int r = r0; r < r1; r++) {
+                    auto row = &cells[r * columnNumber];
+                    
+                    for (int c = c0; c < c1; c++) {
+                        if (auto id = row[c]) {
+                            auto group = spriteGroups[id];
+                            
+                            if (!counts[group]++)
+                                touched.push_back(group);
+                            
+                            occupied++;
+                        }
+                    }
+                }
+                
+                double red = BG_RED, green = BG_GREEN, blue = BG_BLUE;
+                
+                if (occupied) {
+                    double r = 0, g = 0, b = 0;
+                    
+                    // Leagues mix by their share of the units in the block...
+                    for (auto group : touched) {
+                        auto &info = groups[group];
+                        double weight = static_cast<double>(counts[group]) / info.sprites / occupied;
+                        
+                        r += info.red   * weight;
+                        g += info.green * weight;
+                        b += info.blue  * weight;
+                        
+                        counts[group] = 0;
+                    }
+                    
+                    touched.clear();
+                    
+                    // ...and the whole fades out with the density of the block.
+                    double density = std::sqrt(static_cast<double>(occupied) / ((r1 - r0) * (c1 - c0)));
+                    
+                    red   += (r - red)   * density;
+                    green += (g - green) * density;
+                    blue  += (b - blue)  * density;
+                }
+                
+                densityPixels[py * w + px] =
+                0xFF000000u |
+                static_cast<Uint32>(red)   << 16 |
+                static_cast<Uint32>(green) << 8  |
+                static_cast<Uint32>(blue);
+            }
+        }
+    });
+    
+    if (SDL_UpdateTexture(densityTexture, nullptr, densityPixels.data(), w * sizeof(Uint32)))
+        throw UIDisplayError();
+    
+    SDL_Rect rect = {x0, y0, w, h};
+    SDL_RenderCopy(renderer, densityTexture, nullptr, &rect);
 }
 
 void UIDisplay::refresh() {
+    TraceSpan span("refresh");
+    
     if (SDL_SetRenderDrawColor(renderer, BG_RED, BG_GREEN, BG_BLUE, SDL_ALPHA_OPAQUE) ||
         SDL_RenderClear(renderer))
         throw UIDisplayError();
     
-    SDL_Rect rect = {
-        .x = x,
-        .y = y,
-        .w = spriteWidth,
-        .h = spriteHeight
-    };
+    // Past one pixel per cell the board is downsampled instead.
+    if (zoom >= 1)
+        renderCells();
+    else
+        renderDensity();
     
-    for (auto id : screen) {
-        sprites[id].render(renderer, &rect);
+    TraceSpan present("present");
+    SDL_RenderPresent(renderer);
+}
 
-        if ((rect.x += spriteWidth) >= x + width) {
-            rect.x = x;
-            rect.y += spriteHeight;
-        }
-    }
+void UIDisplay::setStatus(const std::string &status) {
+    std::lock_guard<std::mutex> lock(statusMutex);
     
-    SDL_RenderPresent(renderer);
+    this->status  = status;
+    statusChanged = true;
 }
 
 void UIDisplay::startRefreshing() {
+    using Clock = std::chrono::steady_clock;
+    
+    SDL_DisplayMode mode;
+    if (SDL_GetWindowDisplayMode(window, &mode) || mode.refresh_rate <= 0)
+        mode.refresh_rate = 60;
+    
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / mode.refresh_rate)
+    );
+    
+    auto nextFrame = Clock::now();
+    
+    std::uint64_t drawn = generation - 1;
+    bool damaged = true;
+    
+    auto handle = [this, &damaged](const SDL_Event &evt) {
+        if (evt.type == wakeEvent) {
+            wakePending = false;
+            return;
+        }
+        
+        if (handleViewEvent(evt)) {
+            damaged = true;
+            return;
+        }
+        
+        switch (evt.type) {
+            case SDL_QUIT:
+                cont = false;
+                break;
+            case SDL_WINDOWEVENT:
+                damaged = true;
+                break;
+            case SDL_KEYDOWN:
+                if (keyHandler)
+                    keyHandler(evt.key.keysym.sym);
+                
+                break;
+        }
+    };
+    
+    TraceThreadName("render");
+    
     cont = true;
     
     while (cont) {
         SDL_Event evt;
-        while (SDL_PollEvent(&evt)) {
-            switch (evt.type) {
-                case SDL_QUIT:
-                    cont = false;
-                    break;
+        while (SDL_PollEvent(&evt))
+            handle(evt);
+        
+        {
+            std::lock_guard<std::mutex> lock(statusMutex);
+            
+            if (statusChanged) {
+                SDL_SetWindowTitle(window, (status.empty() ? title : title + " - " + status).c_str());
+                statusChanged = false;
+            }
+        }
+        
+        auto now = Clock::now();
+        
+        if (now >= nextFrame) {
+            auto current = generation.load(std::memory_order_acquire);
+            
+            if (damaged || current != drawn) {
+                refresh();
+                
+                // With vsync the present above blocked until the frame was shown.
+                auto end = Clock::now();
+                auto time = std::chrono::duration<float, std::milli>(end - now).count();
+                
+                if (frameTimes.size() < frameWindow)
+                    frameTimes.push_back(time);
+                else
+                    frameTimes[drawnFrames % frameWindow] = time;
+                
+                drawnFrames++;
+                maxFrameTime = std::max(maxFrameTime, time);
+                
+                MetricsAdd(Metric::FramesRendered);
+                MetricsObserve(MetricHistogram::FrameTimeMicros, std::chrono::duration_cast<std::chrono::microseconds>(end - now).count());
+                
+                if (current != drawn) {
+                    auto published = Clock::time_point(Clock::duration(publishedAt.load(std::memory_order_relaxed)));
+                    MetricsObserve(MetricHistogram::RenderLagMicros, std::chrono::duration_cast<std::chrono::microseconds>(end - published).count());
+                }
+                
+                drawn   = current;
+                damaged = false;
+            } else {
+                skippedFrames++;
+                MetricsAdd(Metric::FramesSkipped);
             }
+            
+            if (frameHandler)
+                frameHandler();
+            
+            nextFrame = std::max(nextFrame + interval, Clock::now());
+            continue;
         }
         
-        refresh();
+        // Nothing to do until the next frame is due or something happens.
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame - now).count();
         
-        SDL_Delay(30);
+        if (SDL_WaitEventTimeout(&evt, std::max<int>(timeout, 1)))
+            handle(evt);
     }
+    
+    reportFrameTimes();
+}
+
+void UIDisplay::reportFrameTimes() const {
+    if (frameTimes.empty())
+        return;
+    
+    auto sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    
+    auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+    };
+    
+    std::cout <<
+    "Frames: " << drawnFrames << " drawn, " << skippedFrames << " skipped unchanged\n"
+    "Frame time (ms) over the last " << sorted.size() << ": "
+    "p50 " << percentile(0.5)  << ", "
+    "p90 " << percentile(0.9)  << ", "
+    "p99 " << percentile(0.99) << "; "
+    "max " << maxFrameTime     << '\n';
 }
 
 void UIDisplay::stopRefreshing() {
@@ -6,11 +6,16 @@
 #include <exception>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <functional>
 #include <SDL.h>
 #include "util.hpp"
+#include "pool.hpp"
 
 
-void UIInit();
+void UIInit(bool video = true);
 void UIQuit();
 
 class Sprite {
@@ -22,20 +27,60 @@ private:
     
     std::uint8_t red, green, blue;
     
-    ImplicitPtr<SDL_Surface> surface;
+    /*
+     * An image is decoded when first drawn or rasterized, by whichever copy
+     * of the sprite gets there first, and drawn from textures resampled to
+     * the cell sizes, so runs that never draw it never decode it.
+     */
     
-    ImplicitPtr<SDL_Texture> texture;
+    struct Image {
+        std::string path;
+        std::mutex  mutex;
+        
+        ImplicitPtr<SDL_Surface> surface;
+        
+        // Cells are floor(zoom) or ceil(zoom) pixels along either side, sizes
+        // of different parity, so each of the four shapes has a slot of its own.
+        struct Texture {
+            ImplicitPtr<SDL_Texture> texture;
+            int width = 0, height = 0;
+        } textures[4];
+        
+        bool      averaged = false;
+        SDL_Color average;
+        
+        // Need the mutex.
+        SDL_Surface *decode();
+        SDL_Texture *getTexture(SDL_Renderer *renderer, int w, int h);
+    };
+    
+    std::shared_ptr<Image> image;
+    
+    SDL_Color average;
     
 public:
-    Sprite(std::uint8_t red, std::uint8_t green, std::uint8_t blue) : sourceType(SOURCE_RGB), red(red), green(green), blue(blue) {};
+    Sprite(std::uint8_t red, std::uint8_t green, std::uint8_t blue)
+    : sourceType(SOURCE_RGB), red(red), green(green), blue(blue), average{red, green, blue, SDL_ALPHA_OPAQUE} {};
     Sprite(const char *path);
     
-    void render(SDL_Renderer *renderer, SDL_Rect *rect);
+    // Images are scaled once per cell shape at the current zoom, not on every draw.
+    void render(SDL_Renderer *renderer, const SDL_Rect *rects, int count);
+    
+    // The colour the sprite looks like from far away.
+    SDL_Color getAverageColor() const;
+    
+    // Produces a w x h RGB24 image of the sprite drawn over the background.
+    void rasterize(std::vector<std::uint8_t> &rgb, int w, int h) const;
 };
 
-typedef unsigned int SpriteID;
-
 class UIDisplay {
+public:
+    enum class Output {
+        Window,
+        Offscreen,  // renders into a surface, e.g. for benchmarks
+        None        // only keeps the board and the sprites
+    };
+    
 private:
     int x, y, width, height;
     
@@ -43,12 +88,96 @@ private:
     
     std::vector<SpriteID> screen;
     
+    // What is drawn: 'screen', or a board kept by someone else, see showScreen().
+    const SpriteID *cells;
+    
+    /*
+     * Sprites are grouped, one group per league, for the density map that
+     * is shown when a cell is smaller than a pixel.
+     */
+    
+    struct SpriteGroup {
+        unsigned red = 0, green = 0, blue = 0;
+        unsigned sprites = 0;
+    };
+    
+    std::vector<unsigned>    spriteGroups;
+    std::vector<SpriteGroup> groups;
+    
+    // Averaging decodes images, so it waits until the density map is drawn.
+    bool groupsStale = true;
+    void updateGroups();
+    
+    /*
+     * The viewport: 'zoom' is in pixels per cell and (viewX, viewY) is the
+     * board position, in cells, at the top left corner of the window.
+     */
+    
+    double zoom = 1, viewX = 0, viewY = 0;
+    
+    int  mouseX = 0, mouseY = 0;
+    bool dragging = false;
+    
+    void fitView();
+    void zoomAt(double factor, int px, int py);
+    void pan(double dx, double dy);
+    void clampView();
+    bool handleViewEvent(const SDL_Event &evt);
+    
+    std::vector<std::vector<SDL_Rect>> batches;
+    std::vector<int> edges;
+    
+    void renderCells();
+    
+    std::unique_ptr<ThreadPool> pool;
+    
+    ImplicitPtr<SDL_Texture> densityTexture;
+    int densityWidth = 0, densityHeight = 0;
+    std::vector<Uint32> densityPixels;
+    std::vector<int> densityColumns, densityRows;
+    
+    void renderDensity();
+    
     ImplicitPtr<SDL_Window> window;
+    ImplicitPtr<SDL_Surface> target;
     ImplicitPtr<SDL_Renderer> renderer;
     
     int spriteWidth, spriteHeight;
     int columnNumber, rowNumber;
     
+    Output output;
+    
+    std::string title;
+    
+    std::mutex  statusMutex;
+    std::string status;
+    bool        statusChanged = false;
+    
+    std::function<void(SDL_Keycode)> keyHandler;
+    std::function<void()>            frameHandler;
+    
+    // Board changes since the last publish(), only touched by the simulation.
+    bool unpublished = false;
+    
+    std::atomic<std::uint64_t> generation{0};
+    std::atomic<std::int64_t>  publishedAt{0};
+    std::atomic<bool>          wakePending{false};
+    Uint32                     wakeEvent = 0;
+    
+    /*
+     * Durations of drawn frames in milliseconds, reported at the end: the
+     * last 'frameWindow' of them, the oldest overwritten first, and the
+     * longest of the session.
+     */
+    
+    static const std::size_t frameWindow = 4096;
+    
+    std::vector<float> frameTimes;
+    std::size_t        drawnFrames = 0, skippedFrames = 0;
+    float              maxFrameTime = 0;
+    
+    void reportFrameTimes() const;
+    
     volatile bool cont;
     
 public:
@@ -58,7 +187,8 @@ public:
         int width = -1, int height = -1,
         int columnNumber = 20, int rowNumber = 20,
         bool fullscreen = false,
-        const char *title = ""
+        const char *title = "",
+        Output output = Output::Window
     );
     
     int getX()      const noexcept {return x;}
@@ -66,9 +196,37 @@ public:
     int getWidth()  const noexcept {return width;}
     int getHeight() const noexcept {return height;}
     
-    SpriteID registerSprite(const Sprite &sprite);
+    int getSpriteWidth()  const noexcept {return spriteWidth;}
+    int getSpriteHeight() const noexcept {return spriteHeight;}
+    int getColumnNumber() const noexcept {return columnNumber;}
+    int getRowNumber()    const noexcept {return rowNumber;}
+    
+    Output getOutput()  const noexcept {return output;}
+    bool   isHeadless() const noexcept {return output == Output::None;}
+    
+    const std::vector<Sprite>   &getSprites() const noexcept {return sprites;}
+    const std::vector<SpriteID> &getScreen()  const noexcept {return screen;}
+    
+    // Sprites of one league should share a group.
+    SpriteID registerSprite(const Sprite &sprite, unsigned group = 0);
     void blitSprite(int x, int y, SpriteID id);
     
+    // Makes the blits so far visible to the refreshing thread and wakes it up.
+    void publish();
+    
+    /*
+     * Draws 'cells', a board of the same size that the caller keeps up to
+     * date, instead of the blits. Every publish() then counts as a change.
+     */
+    void showScreen(const SpriteID *cells) {this->cells = cells;}
+    
+    // Shown after the title; may be called from any thread.
+    void setStatus(const std::string &status);
+    
+    // Both are called on the refreshing thread.
+    void setKeyHandler(const std::function<void(SDL_Keycode)> &handler) {keyHandler = handler;}
+    void setFrameHandler(const std::function<void()> &handler)         {frameHandler = handler;}
+    
     void refresh();
     void startRefreshing();
     void stopRefreshing();
@@ -1,17 +1,56 @@
 #include "util.hpp"
 #include <cstdlib>
 #include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #ifdef __linux__
-#include <linux/random.h>
+#include <sys/random.h>
 #endif
 
 using std::uint32_t;
+using std::uint64_t;
 
 
+/*
+ * Seeded numbers come from a per-thread SplitMix64 generator.
+ */
+
+static thread_local uint64_t randomState = 0;
+static thread_local bool     randomSeeded = false;
+
+void SeedRandom(uint64_t seed) {
+    randomState  = seed;
+    randomSeeded = seed != 0;
+}
+
+RandomState SwapRandom(const RandomState &state) {
+    RandomState old;
+    old.state  = randomState;
+    old.seeded = randomSeeded;
+    
+    randomState  = state.state;
+    randomSeeded = state.seeded;
+    
+    return old;
+}
+
+static uint32_t nextSeededRandom() {
+    uint64_t z = (randomState += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    
+    return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+}
+
 uint32_t GetRandom(uint32_t lt) {
     uint32_t rnd;
     
+    if (randomSeeded) {
+        rnd = nextSeededRandom();
+        return lt > 0 ? rnd % lt : rnd;
+    }
+    
 #ifdef UNIX
     /*
      * UNIX.
@@ -28,7 +67,11 @@ uint32_t GetRandom(uint32_t lt) {
      * UNIX: Linux.
      */
     
-    rnd = getrandom((void *)&rnd, sizeof(uint32_t), 0) % lt;
+    if (getrandom((void *)&rnd, sizeof(uint32_t), 0) != sizeof(uint32_t))
+        rnd = rand() | rand() << 16;
+    
+    if (lt > 0)
+        rnd %= lt;
 #else
     /*
      * UNIX: Other.
@@ -59,13 +102,37 @@ void ChangeDir(const char *path) {
 }
 
 std::ifstream FileOpenIn(const char *path, bool binary) {
-    std::ifstream fs(path, binary? std::ios::binary : 0);
+    std::ifstream fs(path, binary? std::ios::binary : std::ios::openmode());
     if (!fs)
         throw FileError(path);
     
     return std::move(fs);
 }
 
+std::string FileStamp(const char *path) {
+#ifdef UNIX
+    struct stat info;
+    if (stat(path, &info))
+        return std::string();
+    
+#ifdef __APPLE__
+    auto nanoseconds = info.st_mtimespec.tv_nsec;
+#else
+    auto nanoseconds = info.st_mtim.tv_nsec;
+#endif
+    
+    return
+    std::to_string(info.st_mtime) + '.' + std::to_string(nanoseconds) + ' ' +
+    std::to_string(info.st_size)  + ' ' + std::to_string(info.st_ino);
+#else
+    struct _stat info;
+    if (_stat(path, &info))
+        return std::string();
+    
+    return std::to_string(info.st_mtime) + ' ' + std::to_string(info.st_size);
+#endif
+}
+
 FileError::FileError(const char *path) {
     reason = std::string("Failed to access: '") + path + "'.";
 }
@@ -7,6 +7,9 @@
 #include <memory>
 #include <exception>
 #include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <cstdint>
 #include <string.h>
 
@@ -29,6 +32,21 @@ namespace sys {
 uint32_t GetRandom(std::uint32_t lt = 0);
 uint32_t GetRandom(std::uint32_t from, std::uint32_t to);
 
+// Makes GetRandom() reproducible on the calling thread, 0 goes back to system randomness.
+void SeedRandom(std::uint64_t seed);
+
+// The calling thread's generator, so that several games can take turns on one thread.
+struct RandomState {
+    std::uint64_t state  = 0;
+    bool          seeded = false;
+};
+
+// Installs 'state' and returns the one it replaces.
+RandomState SwapRandom(const RandomState &state);
+
+// Sprite 0 is the empty cell.
+typedef unsigned int SpriteID;
+
 static inline void FreeString(char *string) {std::free((void *)string);}
 
 template <class T>
@@ -57,6 +75,9 @@ static inline std::ifstream FileOpenIn(const std::string &path, bool binary = fa
     return FileOpenIn(path.c_str());
 }
 
+// Changes whenever the file is written or replaced; empty if it cannot be looked up.
+std::string FileStamp(const char *path);
+
 class FileError : public std::exception {
 private:
     std::string reason;
@@ -96,5 +117,80 @@ public:
     }
 };
 
+/*
+ * A FIFO shared between threads that holds at most 'capacity' items.
+ * Once closed, pushes fail and pop() drains what is left.
+ */
+
+template <class T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    std::size_t capacity;
+    
+    bool closed = false;
+    
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    
+public:
+    BoundedQueue(std::size_t capacity) : capacity(capacity ? capacity : 1) {}
+    
+    bool tryPush(T &&item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            
+            if (closed || items.size() >= capacity)
+                return false;
+            
+            items.push_back(std::move(item));
+        }
+        
+        notEmpty.notify_one();
+        return true;
+    }
+    
+    bool push(T &&item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] {return closed || items.size() < capacity;});
+            
+            if (closed)
+                return false;
+            
+            items.push_back(std::move(item));
+        }
+        
+        notEmpty.notify_one();
+        return true;
+    }
+    
+    bool pop(T &item) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] {return closed || !items.empty();});
+            
+            if (items.empty())
+                return false;
+            
+            item = std::move(items.front());
+            items.pop_front();
+        }
+        
+        notFull.notify_one();
+        return true;
+    }
+    
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
 
 #endif